@@ -8,6 +8,7 @@
 #define __PU_VERSION__ "0.5"
 
 #include <cstring>
+#include <cstdint>
 #include <cmath>
 #include <string>
 #include <vector>
@@ -22,10 +23,20 @@
 #include <array>
 #include <algorithm>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <queue>
+#include <deque>
 #include <condition_variable>
 #include <filesystem>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <limits>
 
 #include <sched.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/sysinfo.h>
@@ -36,12 +47,36 @@
 #endif 
 
 #include "profile_util_gpu.h"
+#include "profile_util_heap.h"
 #include "profile_util_api.h"
 #include "git_revision.h"
 
 namespace profiling_util {
 
     std::string __extract_filename(std::string fullpath);
+    /// offset of the file name in a path, past its directories, which is evaluated at compile
+    /// time for __FILE__ by _PU_FILE
+    constexpr std::size_t __filename_offset(const char *path)
+    {
+        std::size_t offset = 0;
+        for (std::size_t i=0;path[i]!='\0';i++) if (path[i] == '/') offset = i + 1;
+        return offset;
+    }
+    /// location of a call site in the code, see _PU_HERE. It points to the name of the function,
+    /// the name of the file and holds the line, so it is made without allocating
+    struct source_location {
+        const char *function = "";
+        const char *file = "";
+        int line = 0;
+        /// @brief get the reference of the location, "@function file:Lline"
+        /// @return string of the reference
+        std::string ref() const;
+    };
+    template <typename T>
+    inline std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const source_location &loc)
+    {
+        return os << "@" << loc.function << " " << loc.file << ":L" << loc.line;
+    }
 
 #ifdef _MPI
     extern MPI_Comm __comm;
@@ -50,8 +85,9 @@ namespace profiling_util {
     /// function getting version information
     std::string __version();
 
-    /// function that returns a string of the time at when it is called. 
-    std::string __when();
+    /// function that returns a string of the time at when it is called, held in a buffer of the
+    /// calling thread until its next call
+    const char *__when();
     /// function that converts the mask of thread affinity to human readable string 
     void cpuset_to_cstr(cpu_set_t *mask, char *str);
     /// reports the parallelAPI 
@@ -82,11 +118,80 @@ namespace profiling_util {
     std::string MPICallingRank(int task);
 
 
-     /// run a command
+     /// run a command, launched with posix_spawn (see spawn_cmd)
     /// @param cmd string of command to run on system
-    /// @return string of MPI comm rank and thread core affinity 
+    /// @return string of the standard output of the command
     std::string exec_sys_cmd(std::string cmd);
 
+    /// @brief split a command into its arguments if it can be run without a shell
+    /// @param cmd command
+    /// @param args vector of arguments, filled if the command is plain
+    /// @return whether the command is plain, that is has no quoting, pipes, redirection or other shell syntax
+    bool split_plain_cmd(const std::string &cmd, std::vector<std::string> &args);
+
+    /// @brief launch a command with posix_spawn, which unlike fork does not copy the page tables 
+    /// of the calling process, so launching is not slowed by a large resident set. Plain commands 
+    /// are executed directly, other commands through /bin/sh -c
+    /// @param cmd command to launch
+    /// @param out_fd file descriptor to which standard output is redirected, unchanged if negative
+    /// @param err_fd file descriptor to which standard error is redirected, unchanged if negative
+    /// @return process id of the command, -1 if it could not be launched
+    pid_t spawn_cmd(const std::string &cmd, int out_fd = -1, int err_fd = -1);
+
+    /// @brief launch a command with posix_spawn with its standard output and error appended to a file
+    /// @param cmd command to launch
+    /// @param fname file to which output is appended
+    /// @return process id of the command, -1 if it could not be launched
+    pid_t spawn_cmd_to_file(const std::string &cmd, const std::string &fname);
+
+    /// @brief wait for a launched command to finish 
+    /// @param child process id of the command
+    /// @return exit status as returned by waitpid, -1 on failure
+    int wait_cmd(pid_t child);
+
+    /// @brief launch a command with posix_spawn with its standard output connected to a pipe
+    /// @param cmd command to launch
+    /// @param fd set to the read end of the pipe, which the caller closes
+    /// @param nonblocking whether reading the pipe returns rather than blocks when no output is available
+    /// @return process id of the command, -1 if it could not be launched
+    pid_t spawn_cmd_with_pipe(const std::string &cmd, int &fd, bool nonblocking = false);
+
+    /// @brief incremental parser of the comma separated values streamed by a long lived monitor 
+    /// command, such as nvidia-smi --loop-ms. A record is a fixed number of lines (e.g. one per device) 
+    /// of a fixed number of fields. Fields that are not numbers, like N/A, are parsed as 0
+    class CSVStreamParser {
+    protected:
+        int nrows, ncols;
+        /// incomplete last line of the text appended so far
+        std::string partial;
+        /// rows of the record being parsed
+        std::vector<double> record;
+        std::deque<std::vector<double>> records;
+        void _parse_line(const char *begin, const char *end);
+    public:
+        CSVStreamParser(int _nrows = 1, int _ncols = 1) : nrows(_nrows), ncols(_ncols) {}
+        /// @brief parse text read from the stream, which can end mid line
+        /// @param data text
+        /// @param size number of characters
+        void Append(const char *data, size_t size);
+        /// @brief get the next complete record 
+        /// @param values values of the record, row major
+        /// @return whether a complete record was available
+        bool Pop(std::vector<double> &values);
+        /// @return number of complete records not yet popped
+        size_t GetNumRecords() const {return records.size();}
+        int GetNumRows() const {return nrows;}
+        int GetNumCols() const {return ncols;}
+    };
+
+    /// @brief set the GPU monitor command used by samplers, e.g. a path to nvidia-smi or a script 
+    /// producing the same output for testing. The default is the PU_GPU_MONITOR_CMD environment 
+    /// variable if set, otherwise nvidia-smi or rocm-smi 
+    /// @param cmd command
+    void SetGPUMonitorCmd(const std::string &cmd);
+    /// @return the GPU monitor command used by samplers
+    std::string GetGPUMonitorCmd();
+
     namespace detail {
 
         template <int N, typename T>
@@ -243,6 +348,18 @@ namespace profiling_util {
     struct memory_usage {
         memory_stats vm;
         memory_stats rss;
+        /// resident anonymous, file backed and shared memory, only read with the full status 
+        std::size_t rss_anon = 0;
+        std::size_t rss_file = 0;
+        std::size_t rss_shmem = 0;
+        /// proportional set size, which divides shared pages among the processes mapping them, 
+        /// its anonymous and shared memory parts, anonymous transparent huge pages and swap, 
+        /// only read from smaps_rollup
+        std::size_t pss = 0;
+        std::size_t pss_anon = 0;
+        std::size_t pss_shmem = 0;
+        std::size_t anon_hugepages = 0;
+        std::size_t swap = 0;
         memory_usage operator+=(const memory_usage& rhs)
         {
             this->vm.current += rhs.vm.current;
@@ -250,24 +367,49 @@ namespace profiling_util {
             this->vm.change += rhs.vm.change;
 
             this->rss.current += rhs.rss.current;
-            if (this->rss.peak < rhs.rss.peak) this->vm.peak = rhs.rss.peak;
+            if (this->rss.peak < rhs.rss.peak) this->rss.peak = rhs.rss.peak;
             this->rss.change += rhs.rss.change;
+
+            this->rss_anon += rhs.rss_anon;
+            this->rss_file += rhs.rss_file;
+            this->rss_shmem += rhs.rss_shmem;
+
+            this->pss += rhs.pss;
+            this->pss_anon += rhs.pss_anon;
+            this->pss_shmem += rhs.pss_shmem;
+            this->anon_hugepages += rhs.anon_hugepages;
+            this->swap += rhs.swap;
             return *this;
         };
     };
 
     struct sys_memory_stats
     {
-        std::size_t total;
-        std::size_t used;
-        std::size_t free;
-        std::size_t shared;
-        std::size_t cache;
-        std::size_t avail;
+        std::size_t total = 0;
+        std::size_t used = 0;
+        std::size_t free = 0;
+        std::size_t shared = 0;
+        std::size_t cache = 0;
+        std::size_t avail = 0;
+        /// total and free swap
+        std::size_t swap_total = 0;
+        std::size_t swap_free = 0;
+        /// memory waiting to be written back to storage and being written back
+        std::size_t dirty = 0;
+        std::size_t writeback = 0;
+        /// number of huge pages in the pool and free, and their size 
+        std::size_t hugepages_total = 0;
+        std::size_t hugepages_free = 0;
+        std::size_t hugepage_size = 0;
     };
 
-    ///get memory usage
-    memory_usage get_memory_usage();
+    /// get the memory usage of the process. By default the current and peak usage is read from 
+    /// /proc/self/status. If full_status is false, only the current usage is read from 
+    /// /proc/self/statm and the peaks are zero. Neither allocates, 
+    /// the latter is cheap enough to be called every iteration of a loop. 
+    /// If proportional is true, the PSS, huge pages and swap are also read from /proc/self/smaps_rollup, 
+    /// which walks all mappings of the process so is far more costly
+    memory_usage get_memory_usage(bool full_status = true, bool proportional = false);
     ///report memory usage from within a specific function/scope
     ///usage would be from within a function use 
     ///auto l=std::to_string(__LINE__); auto f = __func__; GetMemUsage(f,l);
@@ -277,8 +419,56 @@ namespace profiling_util {
     /// like ReportMemUsage but also returns the mem usage 
     std::tuple<std::string, memory_usage> GetMemUsage(const std::string &f, const std::string &F, const std::string &l);
     std::tuple<std::string, memory_usage> GetMemUsage(const memory_usage &prior_mem_use, const std::string &f, const std::string &F, const std::string &l);
-    /// Get memory usage on all hosts 
     #ifdef _MPI
+    /// communicators of the ranks of a communicator on each node (sharing memory) and of the 
+    /// leaders of the nodes, the lowest rank on each
+    struct mpi_node_comms {
+        MPI_Comm node = MPI_COMM_NULL;
+        /// null on the ranks that do not lead their node
+        MPI_Comm leaders = MPI_COMM_NULL;
+        int node_rank = 0;
+        int node_size = 1;
+        /// index of the node of the rank and the number of nodes
+        int node_index = 0;
+        int nnodes = 1;
+    };
+    /// @brief get the node communicators of a communicator, created by the first call on the 
+    /// communicator, which must be collective, and cached as an attribute of it. 
+    /// They are freed along with the communicator
+    /// @param comm communicator
+    /// @return node communicators
+    const mpi_node_comms &MPIGetNodeComms(MPI_Comm comm);
+    /// a rank or node whose value deviates from the mean, with its hostname
+    struct mpi_outlier {
+        int rank = 0;
+        std::string host;
+        double value = 0;
+    };
+    /// distribution of a value over the ranks or nodes of a communicator, computed by reductions
+    struct mpi_distribution {
+        int count = 0;
+        double mean = 0;
+        double std = 0;
+        double min = 0;
+        double max = 0;
+        /// 50th, 90th and 99th percentiles, interpolated in a histogram of the values
+        double p50 = 0;
+        double p90 = 0;
+        double p99 = 0;
+        /// ranks or nodes deviating most from the mean, in decreasing deviation
+        std::vector<mpi_outlier> outliers;
+    };
+    /// distributions of the memory usage over the ranks and the nodes of a communicator 
+    struct mpi_memory_summary {
+        mpi_distribution rank_rss;
+        mpi_distribution node_rss;
+        mpi_distribution node_pss;
+    };
+    /// Get memory usage on all hosts, summing the usage of the processes on each host. The sum of the 
+    /// PSS, unlike that of the RSS, counts memory shared by the processes, such as MPI shared memory windows, once.
+    /// The usage is reduced on each node and then over the node leaders, so only the root 
+    /// of comm gets the usage of the nodes and the report. The report lists the nodes when they are 
+    /// few and otherwise is the summary of MPIReportNodeMemUsageSummary, without gathering the nodes
     std::string MPIReportNodeMemUsage(MPI_Comm &comm, 
     const std::string &function, 
     const std::string &file,
@@ -289,10 +479,29 @@ namespace profiling_util {
     const std::string &file,
     const std::string &line_num
     );
+    /// @brief Report the distribution of the RSS of the ranks and the RSS and PSS of the nodes,
+    /// their mean, std, min, max and percentiles and the ranks and nodes deviating most from the mean. 
+    /// Computed by reductions, so the size of the report and cost on the root do not grow with the job
+    /// @param comm communicator 
+    /// @param ntop number of outlier ranks and nodes
+    /// @return string of the report, only on the root of comm
+    std::string MPIReportNodeMemUsageSummary(MPI_Comm &comm, 
+    const std::string &function, 
+    const std::string &file,
+    const std::string &line_num,
+    int ntop = 5
+    );
+    std::tuple<std::string, mpi_memory_summary> MPIGetNodeMemUsageSummary(MPI_Comm &comm, 
+    const std::string &function, 
+    const std::string &file,
+    const std::string &line_num,
+    int ntop = 5
+    );
     #endif
 
 
-    /// get the memory of the system using free
+    /// get the memory of the system from /proc/meminfo, falling back to sysinfo(2). 
+    /// Does not launch commands nor allocate so is cheap enough to call in loops
     sys_memory_stats get_system_memory();
     ///report memory state of the system from within a specific function/scope
     ///usage would be from within a function use 
@@ -304,18 +513,154 @@ namespace profiling_util {
     std::tuple<std::string, sys_memory_stats> GetSystemMem(const std::string &f, const std::string &F, const std::string &l);
     std::tuple<std::string, sys_memory_stats> GetSystemMem(const sys_memory_stats &prior_mem_use, const std::string &f, const std::string &F, const std::string &l);
     #ifdef _MPI
+    /// Get the memory of the system of all nodes, read by the node leaders only
     std::string MPIReportNodeSystemMem(MPI_Comm &comm, const std::string &function, const std::string &File, const std::string &line_num);
     std::tuple<std::string, std::vector<std::string>, std::vector<sys_memory_stats>> MPIGetNodeSystemMem(MPI_Comm &comm, const std::string &function, const std::string &File, const std::string &line_num);
     #endif
 
-    /// Timer class. 
-    /// In code create an instance of time and then just a mantter of 
+    /// clocks read by timers and the region profiler
+    enum class clock_source {
+        /// std::chrono::steady_clock, CLOCK_MONOTONIC through the vDSO
+        steady,
+        /// the time stamp counter, rdtsc on x86 and cntvct_el0 on aarch64
+        tsc
+    };
+    /// calibration and state of the clock of timers
+    struct clock_info {
+        /// clock read, the time stamp counter if usable unless set otherwise
+        clock_source source = clock_source::steady;
+        /// whether the time stamp counter can be used, that is it runs at a constant rate in
+        /// all power states (invariant TSC) and the kernel keeps time with it
+        bool tsc_usable = false;
+        /// why the time stamp counter is not usable
+        std::string tsc_reason;
+        /// frequency of the counter calibrated against CLOCK_MONOTONIC [GHz] and the time
+        /// taken to calibrate [ns]
+        double tsc_ghz = 0;
+        int64_t calibration_time = 0;
+    };
+
+    namespace detail {
+        /// state of the clock, calibrated when the library is loaded. Times of the counter are
+        /// offset to be those of steady_clock at calibration, so the clocks can be swapped
+        struct _clock_state {
+            std::atomic<bool> use_tsc;
+            double ns_per_tick;
+            uint64_t tsc0;
+            int64_t ns0;
+        };
+        extern _clock_state __clock;
+
+        inline uint64_t _read_tsc()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+            uint64_t ticks;
+            asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+            return ticks;
+#else
+            return 0;
+#endif
+        }
+
+        /// add to a counter written by a single thread and read by others, which need not pay
+        /// for an atomic read modify write
+        template <typename T> inline void _single_writer_add(std::atomic<T> &counter, T amount)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+    }
+
+    /// Clock of timers, reading the time stamp counter converted to ns where it is usable and
+    /// steady_clock otherwise, see SetClockSource. Meets the requirements of a std::chrono clock
+    struct pu_clock {
+        using duration = std::chrono::nanoseconds;
+        using rep = duration::rep;
+        using period = duration::period;
+        using time_point = std::chrono::time_point<pu_clock>;
+        static constexpr bool is_steady = true;
+        static time_point now() noexcept
+        {
+            auto &c = detail::__clock;
+            if (c.use_tsc.load(std::memory_order_acquire))
+            {
+                auto ticks = static_cast<int64_t>(detail::_read_tsc() - c.tsc0);
+                return time_point(duration(c.ns0 + static_cast<rep>(ticks * c.ns_per_tick)));
+            }
+            return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+        }
+    };
+
+    /// @brief set the clock read by timers and the region profiler, which is the time stamp
+    /// counter by default where it is usable. The default can be set with the PU_CLOCK
+    /// environment variable, steady or tsc. Times taken with either clock can be compared
+    /// @param source clock to read
+    /// @return bool of whether the clock is used, false when the counter is not usable
+    bool SetClockSource(clock_source source);
+    /// @brief get the clock read by timers and the calibration of the time stamp counter
+    /// @return clock info
+    clock_info get_clock_info();
+
+    /// Log-linear histogram of times, like HdrHistogram: exact below 2^bits ns and above
+    /// split into 2^(bits-1) buckets per power of two, which keeps the relative error of any
+    /// time below 10^-digits for the number of significant digits asked for. The memory is
+    /// fixed when made and recording is O(1) and does not allocate. Recording is not thread
+    /// safe, so each thread records into its own, which are merged after
+    class lap_histogram {
+    public:
+        /// @param significant_digits decimal digits kept of each time, 1 to 4, with 2 taking
+        /// 58 kB and each more digit about 8 times that
+        explicit lap_histogram(int significant_digits = 2);
+
+        inline void record(uint64_t time)
+        {
+            counts[_index(time)]++;
+            count++;
+            sum += time;
+            if (time < min) min = time;
+            if (time > max) max = time;
+        }
+        /// add the times of another histogram, rebinned if its precision differs
+        void merge(const lap_histogram &other);
+        void reset();
+        /// @brief time below which the given percentage of the times are, the upper bound of
+        /// its bucket and no more than the max
+        /// @param percentile in [0,100]
+        /// @return time [ns]
+        uint64_t get_percentile(double percentile) const;
+        uint64_t get_count() const {return count;}
+        uint64_t get_min() const {return count > 0 ? min : 0;}
+        uint64_t get_max() const {return max;}
+        double get_mean() const {return count > 0 ? static_cast<double>(sum) / count : 0;}
+        int get_significant_digits() const {return digits;}
+        std::size_t get_nbuckets() const {return counts.size();}
+
+    private:
+        int digits;
+        // bits of the times below which they are exact
+        int bits;
+        std::vector<uint64_t> counts;
+        uint64_t count = 0, sum = 0, min = std::numeric_limits<uint64_t>::max(), max = 0;
+        inline std::size_t _index(uint64_t time) const
+        {
+            if (time < (uint64_t(1) << bits)) return time;
+            int msb = 63 - __builtin_clzll(time);
+            int shift = msb - bits + 1;
+            return (std::size_t(1) << bits) + (std::size_t(msb - bits) << (bits - 1)) + ((time >> shift) - (uint64_t(1) << (bits - 1)));
+        }
+        // least and greatest time of a bucket
+        std::pair<uint64_t, uint64_t> _bounds(std::size_t index) const;
+    };
+
+    /// Timer class.
+    /// In code create an instance of time and then just a mantter of
     /// creating an instance and then reporting it. 
     class Timer {
 
     public:
 
-        using clock = std::chrono::high_resolution_clock;
+        using clock = pu_clock;
         using duration = typename std::chrono::nanoseconds::rep;
         
 
@@ -405,10 +750,36 @@ namespace profiling_util {
             }
 #endif
         };
+        /// the reference is made from the location of creation on request, unless set
         std::string get_ref() const 
         {
-            return ref;
+            return ref.empty() ? loc.ref() : ref;
         };
+        const source_location &get_location() const {return loc;}
+
+        /*!
+         * Records the time since the previous lap in the lap histogram of the timer, which
+         * set_laps makes, so recording does not allocate. Laps are not recorded before. A
+         * timer is lapped by one thread, copies of it having laps of their own
+         *
+         * @return The time of the lap [ns]
+         */
+        inline
+        duration lap() {
+            auto now = clock::now();
+            auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(now - tlap).count();
+            tlap = now;
+            if (laps) laps->record(time < 0 ? 0 : time);
+            return time;
+        }
+        /// make the lap histogram with a given precision, the next lap starting now
+        void set_laps(int significant_digits = 2)
+        {
+            laps.emplace(significant_digits);
+            tlap = clock::now();
+        }
+        /// the lap histogram, null before set_laps
+        const lap_histogram *get_laps() const {return laps ? &*laps : nullptr;}
 #if defined(_GPU)
         std::string get_device_swap_info()
         {
@@ -419,23 +790,13 @@ namespace profiling_util {
         };
 #endif
 
+        /// creating a timer at a source location (see NewTimer) does not allocate on the host
+        Timer(const source_location &_loc, bool _use_device=true) : loc(_loc) {
+            _init(_use_device);
+        }
         Timer(const std::string &f, const std::string &F, const std::string &l, bool _use_device=true) {
             ref="@"+f+" "+F+":L"+l;
-            t0 = clock::now();
-            tref = t0;
-            use_device = _use_device;
-#if defined(_GPU)
-            int ndevices;
-            pu_gpuErrorCheck(pu_gpuGetDeviceCount(&ndevices));
-            if (ndevices == 0) use_device = false;
-            if (use_device) {
-                pu_gpuErrorCheck(pu_gpuGetDevice(&device_id));
-                pu_gpuErrorCheck(pu_gpuEventCreate(&t0_event));
-                pu_gpuErrorCheck(pu_gpuEventRecord(t0_event)); 
-                pu_gpuErrorCheck(pu_gpuEventSynchronize(t0_event));
-                other_device_id = device_id;
-            }
-#endif
+            _init(_use_device);
         }
 #if defined(_GPU)
         ~Timer()
@@ -456,8 +817,11 @@ namespace profiling_util {
     protected:
         clock::time_point t0;
         clock::time_point tref;
+        source_location loc;
+        clock::time_point tlap;
         std::string ref;
         bool use_device = true;
+        std::optional<lap_histogram> laps;
 #if defined(_GPU)
         pu_gpuEvent_t t0_event;
         // store the device on which event is recorded
@@ -465,6 +829,26 @@ namespace profiling_util {
         int device_id, other_device_id;
         bool swap_device = false;
 #endif
+
+    private:
+        void _init(bool _use_device) {
+            t0 = clock::now();
+            tref = t0;
+            tlap = t0;
+            use_device = _use_device;
+#if defined(_GPU)
+            int ndevices;
+            pu_gpuErrorCheck(pu_gpuGetDeviceCount(&ndevices));
+            if (ndevices == 0) use_device = false;
+            if (use_device) {
+                pu_gpuErrorCheck(pu_gpuGetDevice(&device_id));
+                pu_gpuErrorCheck(pu_gpuEventCreate(&t0_event));
+                pu_gpuErrorCheck(pu_gpuEventRecord(t0_event)); 
+                pu_gpuErrorCheck(pu_gpuEventSynchronize(t0_event));
+                other_device_id = device_id;
+            }
+#endif
+        }
     };
 
     /// @brief report the time taken between some reference time (which defaults to creation of timer )
@@ -484,6 +868,21 @@ namespace profiling_util {
     /// @param l string of line number in file where the ReporTimeTaken is called (at least that is the idea)
     /// @return time taken 
     float GetTimeTaken(Timer &t, const std::string &f, const std::string &F, const std::string &l);
+    /// @brief like ReportTimeTaken, called at a source location (see _PU_HERE)
+    std::string ReportTimeTaken(Timer &t, const source_location &where);
+    /// @brief like GetTimeTaken, called at a source location (see _PU_HERE)
+    float GetTimeTaken(Timer &t, const source_location &where);
+    /// @brief report the percentiles of the laps of a timer, see Timer::lap
+    /// @param t instance of timer class
+    /// @param where source location of the call
+    /// @return string reporting the count, mean, p50, p90, p99, p99.9 and max of the laps
+    std::string ReportLaps(Timer &t, const source_location &where);
+    /// @brief like ReportLaps, for a histogram, such as the laps of several threads merged
+    /// @param laps histogram
+    /// @param name name of the times reported
+    /// @param where source location of the call
+    /// @return string reporting the count, mean, p50, p90, p99, p99.9 and max of the laps
+    std::string ReportLaps(const lap_histogram &laps, const std::string &name, const source_location &where);
 
 #if defined(_GPU)
     /// @brief report the time taken between some reference time (which defaults to creation of timer )
@@ -502,8 +901,262 @@ namespace profiling_util {
     /// @param l string of line number in file where the ReporTimeTaken is called (at least that is the idea)
     /// @return time taken 
     float GetTimeTakenOnDevice(Timer &t, const std::string &f, const std::string &F, const std::string &l);
+    /// @brief like ReportTimeTakenOnDevice, called at a source location (see _PU_HERE)
+    std::string ReportTimeTakenOnDevice(Timer &t, const source_location &where);
+    /// @brief like GetTimeTakenOnDevice, called at a source location (see _PU_HERE)
+    float GetTimeTakenOnDevice(Timer &t, const source_location &where);
 #endif
 
+    /// times of a region of the region profiler at one place in the call tree, that is nested in
+    /// the same enclosing regions, summed over the threads that entered it there
+    struct region_stats {
+        /// identity and name of the region, where it is declared and its depth in the call tree
+        int region = -1;
+        std::string name;
+        std::string ref;
+        int depth = 0;
+        /// number of times the region was entered and the number of threads that entered it
+        uint64_t count = 0;
+        int nthreads = 0;
+        /// total, shortest and longest time spent in the region and the time spent in the regions
+        /// entered within it [ns]
+        Timer::duration total = 0;
+        Timer::duration min = 0;
+        Timer::duration max = 0;
+        Timer::duration children = 0;
+        /// time spent in the region itself [ns]
+        Timer::duration self() const {return total - children;}
+    };
+    /// @brief register a region of the region profiler, done once by each PU_REGION
+    /// @param name name of the region
+    /// @param where location where the region is declared
+    /// @return identity of the region
+    int RegisterRegion(const std::string &name, const source_location &where);
+    /// @brief enter a region on the calling thread, nested within the region the thread is in
+    /// @param region identity of the region
+    void EnterRegion(int region);
+    /// @brief exit the region the calling thread last entered
+    void ExitRegion();
+
+    /// RegionScope class entering a region of the region profiler on creation and exiting it on
+    /// destruction, see PU_REGION. The count, total, min, max and self time of the region are
+    /// accumulated in the call tree of the calling thread, where a region is identified by the
+    /// regions it is nested in. Entering and exiting takes two reads of the clock and a lookup
+    /// among the regions entered from the enclosing one, no locks nor allocations once seen.
+    /// Threads have call trees of their own, so regions entered by the threads of an OpenMP
+    /// parallel region are only nested in the enclosing regions for the thread that entered those
+    class RegionScope {
+    public:
+        explicit RegionScope(int region) {EnterRegion(region);}
+        ~RegionScope() {ExitRegion();}
+        RegionScope(const RegionScope &) = delete;
+        RegionScope &operator=(const RegionScope &) = delete;
+    };
+    /// RegionReportScope class, a RegionScope that reports the call tree within its region
+    /// to std::cout on destruction, see PU_REGION_REPORT
+    class RegionReportScope {
+    private:
+        int region;
+        source_location where;
+    public:
+        RegionReportScope(int _region, const source_location &_where);
+        ~RegionReportScope();
+        RegionReportScope(const RegionReportScope &) = delete;
+        RegionReportScope &operator=(const RegionReportScope &) = delete;
+    };
+    /// @brief get the call tree of the regions merged across threads, in depth first order with
+    /// regions in the order they were first entered. Regions still being executed by other
+    /// threads are included up to their last exit
+    /// @param region only the subtrees rooted at this region, all regions if negative
+    /// @return vector of region stats
+    std::vector<region_stats> get_region_stats(int region = -1);
+    /// @brief report the call tree of the regions merged across threads, one line per region
+    /// indented by its depth. Once reported, the call tree is no longer reported at program exit
+    /// @param f function where called in code, useful to provide __func__
+    /// @param F function where called in code, useful to provide __FILE__
+    /// @param l code line number where called
+    /// @param region only the subtrees rooted at this region, all regions if negative
+    /// @return string of the call tree
+    std::string ReportRegions(const std::string &f, const std::string &F, const std::string &l, int region = -1);
+    /// @brief set whether the call tree of the regions is reported to std::cout at program exit,
+    /// which it is unless it has been reported already
+    /// @param report bool of whether to report
+    void SetRegionReportAtExit(bool report);
+
+    /// cost of the timers and regions of the library reading a clock, measured on a thread
+    struct timer_overhead {
+        clock_source source = clock_source::steady;
+        /// whether measured, which the time stamp counter is not if it is not usable or calibrated
+        bool valid = false;
+        /// cost of reading the clock, as Timer::get does [ns]
+        double read = 0;
+        /// cost of entering and exiting a region, and the part of it between the reads of the
+        /// clock, which is what an empty region measures [ns]
+        double region = 0;
+        double region_inner = 0;
+    };
+    /// @brief measure the overhead of timers and regions with the clock in use on the calling
+    /// thread, which is then used to correct the regions of the thread. Every usable clock is
+    /// measured when the library is loaded, which is used for threads not measured themselves
+    /// @return timer overhead
+    timer_overhead CalibrateTimerOverhead();
+    /// @brief get the overhead of a clock, measured on the calling thread if it was, otherwise
+    /// when the library was loaded
+    /// @param source clock
+    /// @return timer overhead
+    timer_overhead get_timer_overhead(clock_source source);
+    /// @brief set whether the overhead of regions is subtracted from the times of the regions in
+    /// reports, which it is not by default. Each entry of a region is less the part of the
+    /// overhead within it, and the entries of the regions nested within it less their overhead
+    /// @param subtract bool of whether to subtract
+    void SetRegionOverheadSubtraction(bool subtract);
+    /// @brief report the overhead of timers and regions with each clock, like ReportParallelAPI
+    /// @return string of the overheads
+    std::string ReportTimerOverhead();
+
+    /// allocations and bytes requested of a region or allocation site
+    struct heap_alloc_stats {
+        std::string name;
+        uintptr_t site = 0;
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+    /// state of the heap allocation tracker, summed over threads
+    struct heap_stats {
+        /// whether the tracker library is loaded, all else is zero otherwise 
+        bool active = false;
+        uint64_t count = 0;
+        uint64_t frees = 0;
+        uint64_t bytes = 0;
+        int64_t live_bytes = 0;
+        /// number of allocations with sizes in [2^(i-1), 2^i)
+        std::array<uint64_t, PU_HEAP_NBINS> histogram{};
+        /// regions and sites that allocated, the latter in decreasing number of allocations
+        std::vector<heap_alloc_stats> regions;
+        std::vector<heap_alloc_stats> sites;
+    };
+    /// @brief get whether the heap allocation tracker library (profile_util_heap) is linked or preloaded
+    /// @return bool of whether heap allocations are tracked
+    bool heap_tracker_loaded();
+    /// @brief get the allocations tracked so far
+    /// @return heap stats
+    heap_stats get_heap_stats();
+    /// @brief attribute the following allocations of the calling thread to the region of a timer, 
+    /// named by its reference (see Timer::get_ref)
+    /// @param t timer of the region
+    void SetHeapRegion(const Timer &t);
+    /// @brief stop attributing the allocations of the calling thread to a region
+    void ClearHeapRegion();
+    /// @brief report the allocations tracked by the heap allocation tracker, with the size histogram,
+    /// regions and top allocating sites
+    /// @param f function where called in code, useful to provide __func__ 
+    /// @param F function where called in code, useful to provide __FILE__ 
+    /// @param l code line number where called
+    /// @param nsites number of sites reported
+    /// @return string of heap allocations
+    std::string ReportHeapStats(const std::string &f, const std::string &F, const std::string &l, int nsites = 10);
+    /// @brief report the allocations since a prior state of the heap per iteration of a loop
+    /// @param prior heap stats before the loop
+    /// @param niterations number of iterations since then
+    /// @return string of heap allocations
+    std::string ReportHeapStats(const heap_stats &prior, std::size_t niterations, const std::string &f, const std::string &F, const std::string &l, int nsites = 10);
+
+    /// free chunks and memory of a glibc malloc arena, from malloc_info
+    struct malloc_arena_state {
+        int nr = 0;
+        /// free chunks in the fast bins and in the other bins
+        std::size_t fast_count = 0;
+        std::size_t fast_bytes = 0;
+        std::size_t free_count = 0;
+        std::size_t free_bytes = 0;
+        /// memory the arena holds from the system, currently and at most
+        std::size_t system_bytes = 0;
+        std::size_t max_system_bytes = 0;
+    };
+    /// state of the glibc allocator, from mallinfo2 and malloc_info 
+    struct heap_state {
+        /// whether the state could be read, only with glibc
+        bool valid = false;
+        /// memory held by the arenas (other than mmapped chunks), in use and free, 
+        /// the free memory in fast bins, and the number of free chunks 
+        std::size_t arena_bytes = 0;
+        std::size_t in_use_bytes = 0;
+        std::size_t free_bytes = 0;
+        std::size_t fastbin_bytes = 0;
+        std::size_t free_chunks = 0;
+        /// free memory at the top of the main arena, which malloc_trim can return to the system 
+        std::size_t top_bytes = 0;
+        /// chunks allocated with mmap and their memory
+        std::size_t mmap_count = 0;
+        std::size_t mmap_bytes = 0;
+        std::vector<malloc_arena_state> arenas;
+        /// fraction of the memory held by the arenas that is free
+        double free_fraction() const {return arena_bytes > 0 ? static_cast<double>(free_bytes) / arena_bytes : 0.0;}
+        /// fraction of the memory held by the arenas that is free in holes between chunks in use,
+        /// which is not returned to the system as the top of the arena would be
+        double fragmentation() const {return arena_bytes > 0 ? static_cast<double>(free_bytes - std::min(top_bytes, free_bytes)) / arena_bytes : 0.0;}
+    };
+    /// @brief get the state of the glibc allocator, its arenas and their free memory, 
+    /// to tell fragmentation from memory held by many arenas or at their top
+    /// @return heap state, not valid without glibc
+    heap_state get_heap_state();
+    /// @brief report the state of the glibc allocator with its fragmentation and arenas 
+    /// @param f function where called in code, useful to provide __func__ 
+    /// @param F function where called in code, useful to provide __FILE__ 
+    /// @param l code line number where called
+    /// @param trim whether to return free memory to the system with malloc_trim, 
+    /// reporting the state and RSS before and after
+    /// @return string of heap state
+    std::string ReportHeapState(const std::string &f, const std::string &F, const std::string &l, bool trim = false);
+    /// like ReportHeapState but also returns the heap state (after trimming)
+    std::tuple<std::string, heap_state> GetHeapState(const std::string &f, const std::string &F, const std::string &l, bool trim = false);
+
+    /// placement of the pages of a range of memory on the NUMA nodes
+    struct numa_placement {
+        /// whether the placement could be queried
+        bool valid = false;
+        /// pages spanned by the range, pages sampled and sampled pages not present, 
+        /// not yet touched or swapped out
+        std::size_t npages = 0;
+        std::size_t nsampled = 0;
+        std::size_t not_present = 0;
+        /// sampled pages on each node
+        std::vector<std::size_t> node_pages;
+        /// number of sampled pages present on the given nodes
+        std::size_t pages_on(const std::vector<bool> &nodes) const 
+        {
+            std::size_t n = 0;
+            for (std::size_t i=0;i<node_pages.size() && i<nodes.size();i++) if (nodes[i]) n += node_pages[i];
+            return n;
+        }
+    };
+    /// @brief get the NUMA node of each cpu, from /sys/devices/system/node, all on node 0 without NUMA
+    /// @return vector of the node of each cpu
+    const std::vector<int> &get_cpu_numa_nodes();
+    /// @brief get the NUMA nodes of the cpus a thread may run on 
+    /// @param mask affinity of the thread 
+    /// @return vector flagging the nodes
+    std::vector<bool> get_numa_nodes(const cpu_set_t &mask);
+    /// @brief get the NUMA nodes of a range of memory by querying a sample of its pages with move_pages(2), 
+    /// which does not move them when no nodes are given
+    /// @param ptr start of the range
+    /// @param bytes size of the range 
+    /// @param nsamples number of pages sampled, evenly spaced over the range
+    /// @return placement of the sampled pages 
+    numa_placement get_numa_placement(const void *ptr, std::size_t bytes, std::size_t nsamples = 1024);
+    /// @brief report the NUMA nodes of a range of memory and, with the thread affinity of each thread 
+    /// of the OpenMP team, the placement of the part of the range the thread touches with a static schedule,
+    /// flagging the parts mostly remote from the thread. Called within a parallel region, only the 
+    /// calling thread is reported, with the whole range
+    /// @param ptr start of the range
+    /// @param bytes size of the range 
+    /// @param f function where called in code, useful to provide __func__ 
+    /// @param F function where called in code, useful to provide __FILE__ 
+    /// @param l code line number where called
+    /// @param nsamples number of pages sampled
+    /// @return string of the placement
+    std::string ReportNUMAPlacement(const void *ptr, std::size_t bytes, const std::string &f, const std::string &F, const std::string &l, std::size_t nsamples = 1024);
+
     /// @brief get the ave, std, min, max of input vector
     /// @param input input vector
     template <typename T> std::tuple<T,T,T,T,int>get_stats(std::vector<T> &input, unsigned int offset = 0, unsigned int stride = 1)
@@ -527,7 +1180,474 @@ namespace profiling_util {
         return std::tie(ave, std, min, max, nsample);
     }
 
-    /// @brief GeneralSampler class that runs a command as a thread and stores output
+    /// IO of the calling process as counted in /proc/self/io
+    struct io_counters {
+        /// whether the counters could be read
+        bool valid = false;
+        /// bytes read and written by read and write calls, including those served by the page cache
+        uint64_t rchar = 0, wchar = 0;
+        /// number of read and write calls
+        uint64_t syscr = 0, syscw = 0;
+        /// bytes fetched from and sent to the storage layer
+        uint64_t read_bytes = 0, write_bytes = 0;
+        /// bytes that were not written to storage because the dirty pages were truncated
+        uint64_t cancelled_write_bytes = 0;
+    };
+
+    /// get the IO counters of the calling process by reading /proc/self/io in-process
+    io_counters get_io_counters();
+
+    /// @brief integrate sampled values over the times at which they were taken using the trapezoidal rule
+    /// @param times vector of sample times in seconds, one per record
+    /// @param input vector of values, stride values per record
+    /// @return integral of values over time, i.e., units of value times seconds
+    template <typename T> T integrate_samples(const std::vector<T> &times, const std::vector<T> &input, unsigned int offset = 0, unsigned int stride = 1)
+    {
+        T integral = 0;
+        for (size_t i=1;i<times.size();i++)
+        {
+            auto j = i*stride + offset;
+            if (j >= input.size()) break;
+            integral += 0.5*(input[j]+input[j-stride])*(times[i]-times[i-1]);
+        }
+        return integral;
+    }
+
+    /// @brief get the achieved sampling rate and jitter of the sampling intervals 
+    /// @param times vector of sample times in seconds
+    /// @param period requested sampling period in seconds
+    /// @return tuple of rate [Hz], ave, std and max absolute deviation of intervals from period [s], number of samples
+    template <typename T> std::tuple<T,T,T,T,int>get_sampling_stats(const std::vector<T> &times, T period)
+    {
+        T rate = 0, ave = 0, std = 0, maxdev = 0;
+        int nsample = times.size();
+        if (nsample > 1) {
+            std::vector<T> intervals(nsample-1);
+            for (auto i=1;i<nsample;i++) 
+            {
+                intervals[i-1] = times[i]-times[i-1];
+                maxdev = std::max(maxdev, std::abs(intervals[i-1]-period));
+            }
+            T min, max;
+            int n;
+            std::tie(ave, std, min, max, n) = get_stats(intervals);
+            rate = (nsample-1)/(times[nsample-1]-times[0]);
+        }
+        return std::make_tuple(rate, ave, std, maxdev, nsample);
+    }
+
+    /// @brief running totals of a sampled metric over all its samples, including those no longer
+    /// retained by its buffer
+    struct sample_totals {
+        /// totals of one of the values of the records
+        struct value_totals {
+            double sum = 0, sum2 = 0, min = 0, max = 0, first = 0, last = 0;
+            /// integral over the sample times using the trapezoidal rule
+            double integral = 0;
+        };
+        /// number of samples and the times of the first and last
+        std::size_t count = 0;
+        double first_time = 0, last_time = 0;
+        /// totals of each value of the records
+        std::vector<value_totals> values;
+    };
+
+    /// @brief get the ave, std, min, max of a value of a metric from its running totals, 
+    /// as get_stats does from its samples
+    /// @param totals running totals 
+    /// @param offset index of the value in the records
+    inline std::tuple<double,double,double,double,int> get_stats(const sample_totals &totals, unsigned int offset = 0)
+    {
+        double ave = 0, std = 0, min = 0, max = 0;
+        int nsample = totals.count;
+        if (nsample > 0 && offset < totals.values.size()) {
+            auto &v = totals.values[offset];
+            ave = v.sum / nsample;
+            min = v.min;
+            max = v.max;
+            if (nsample > 1) std = sqrt(std::max(0.0, v.sum2-ave*ave*nsample))/(nsample-1.0);
+        }
+        return std::make_tuple(ave, std, min, max, nsample);
+    }
+
+    /// @brief SampleBuffer class, a bounded single producer single consumer ring buffer
+    /// of timestamped samples. Each record holds the time at which it was taken and
+    /// width values (for instance one per device). The producer never blocks, overwriting
+    /// the oldest records when full, and readers take a consistent snapshot of
+    /// the retained records without stopping the producer. Running totals of all records pushed
+    /// are kept alongside, so statistics are not limited to the records retained. The buffer either owns its memory
+    /// or is placed in memory provided by the caller, such as an MPI shared memory window, 
+    /// in which case the producer and readers can be different processes.
+    class SampleBuffer {
+
+    protected:
+        struct buffer_header {
+            /// number of records pushed so far, records in [head-capacity, head) are retained
+            std::atomic<std::size_t> head;
+            std::size_t width;
+            std::size_t capacity;
+            /// odd while the producer updates the totals, which readers retry if it changed
+            std::atomic<std::size_t> totals_seq;
+            std::size_t count;
+            double first_time, last_time;
+        };
+        using value_totals = sample_totals::value_totals;
+        std::unique_ptr<char[]> storage;
+        buffer_header *header = nullptr;
+        double *times = nullptr;
+        double *values = nullptr;
+        value_totals *totals = nullptr;
+        std::size_t width = 1;
+        std::size_t capacity = 0;
+
+        void _place(char *memory, bool init)
+        {
+            header = reinterpret_cast<buffer_header *>(memory);
+            if (init) 
+            {
+                new (&header->head) std::atomic<std::size_t>(0);
+                header->width = width;
+                header->capacity = capacity;
+                new (&header->totals_seq) std::atomic<std::size_t>(0);
+                header->count = 0;
+                header->first_time = header->last_time = 0;
+            }
+            width = header->width;
+            capacity = header->capacity;
+            times = reinterpret_cast<double *>(memory + _header_bytes());
+            values = times + capacity;
+            totals = reinterpret_cast<value_totals *>(values + capacity * width);
+            if (init) std::fill(totals, totals + width, value_totals());
+        }
+        /// @brief add a record to the running totals
+        inline void _add_totals(double time, const double *vals)
+        {
+            if (header->count == 0) 
+            {
+                header->first_time = time;
+                for (std::size_t i=0;i<width;i++) totals[i].min = totals[i].max = totals[i].first = vals[i];
+            }
+            for (std::size_t i=0;i<width;i++) 
+            {
+                auto &t = totals[i];
+                if (header->count > 0) t.integral += 0.5*(vals[i]+t.last)*(time-header->last_time);
+                t.sum += vals[i];
+                t.sum2 += vals[i]*vals[i];
+                t.min = std::min(t.min, vals[i]);
+                t.max = std::max(t.max, vals[i]);
+                t.last = vals[i];
+            }
+            header->last_time = time;
+            header->count++;
+        }
+        static constexpr std::size_t _header_bytes()
+        {
+            return (sizeof(buffer_header) + 63) / 64 * 64;
+        }
+
+    public:
+        static constexpr std::size_t default_capacity = 1 << 16;
+        /// @brief make a buffer owning its memory
+        /// @param _width number of values per record
+        /// @param _capacity number of records retained
+        SampleBuffer(std::size_t _width = 1, std::size_t _capacity = default_capacity)
+        {
+            width = std::max<std::size_t>(_width, 1);
+            capacity = std::max<std::size_t>(_capacity, 1);
+            storage.reset(new char[GetRequiredBytes(width, capacity)]);
+            _place(storage.get(), true);
+        }
+        /// @brief make a buffer in memory provided by the caller 
+        /// @param memory memory of at least GetRequiredBytes(_width, _capacity) bytes, 8 byte aligned
+        /// @param _width number of values per record
+        /// @param _capacity number of records retained
+        /// @param init whether to initialise the buffer or attach to one already initialised in this memory
+        SampleBuffer(void *memory, std::size_t _width, std::size_t _capacity, bool init)
+        {
+            width = std::max<std::size_t>(_width, 1);
+            capacity = std::max<std::size_t>(_capacity, 1);
+            _place(reinterpret_cast<char *>(memory), init);
+        }
+        SampleBuffer(const SampleBuffer &) = delete;
+        SampleBuffer &operator=(const SampleBuffer &) = delete;
+        /// @brief get the number of bytes of memory needed by a buffer, rounded up to a cache line
+        static std::size_t GetRequiredBytes(std::size_t _width, std::size_t _capacity)
+        {
+            auto bytes = _header_bytes() + _capacity * (_width + 1) * sizeof(double) + _width * sizeof(value_totals);
+            return (bytes + 63) / 64 * 64;
+        }
+        /// @brief add a record, only to be called from the single producer
+        /// @param time time of the sample
+        /// @param vals pointer to width values
+        inline void push(double time, const double *vals)
+        {
+            auto n = header->head.load(std::memory_order_relaxed);
+            auto slot = n % capacity;
+            auto seq = header->totals_seq.load(std::memory_order_relaxed);
+            header->totals_seq.store(seq + 1, std::memory_order_relaxed);
+            // as the writer of a seqlock, so a reader that sees any of the writes below of the
+            // slot also sees the head of this record and drops it (see Snapshot), and a reader
+            // of the totals sees the odd sequence number and retries (see GetTotals)
+            std::atomic_thread_fence(std::memory_order_release);
+            times[slot] = time;
+            std::copy(vals, vals + width, values + slot * width);
+            _add_totals(time, vals);
+            header->totals_seq.store(seq + 2, std::memory_order_release);
+            header->head.store(n + 1, std::memory_order_release);
+        }
+        /// @brief get the number of values per record
+        std::size_t GetWidth() const {return width;}
+        /// @brief get the maximum number of records retained
+        std::size_t GetCapacity() const {return capacity;}
+        /// @brief get the number of records pushed since creation
+        std::size_t GetNumPushed() const {return header->head.load(std::memory_order_acquire);}
+        /// @brief copy the retained records
+        /// @param snap_times vector storing the time of each record
+        /// @param snap_values vector storing the values of records, width values per record
+        void Snapshot(std::vector<double> &snap_times, std::vector<double> &snap_values) const;
+        /// @brief copy the running totals of all records pushed
+        /// @param snap_totals totals, with one entry of values per value of the records
+        void GetTotals(sample_totals &snap_totals) const;
+    };
+
+    /// @brief SamplerScheduler class, a single thread per process that runs the sampling tasks
+    /// of all samplers, each at its own period. Tasks are ordered in a heap of absolute deadlines
+    /// so that the time taken by a task does not add to its period.
+    class SamplerScheduler {
+
+    public:
+        using clock = std::chrono::steady_clock;
+
+    protected:
+        struct task_entry {
+            std::function<void()> func;
+            clock::duration period;
+            clock::time_point deadline;
+            /// set by Remove while it waits for the task to finish, so the task is not run again.
+            /// A task removed by itself is erased when it returns
+            bool removed = false;
+        };
+        std::thread thread;
+        std::mutex mtx;
+        std::condition_variable cv;
+        /// signals the end of a task so that tasks can be safely removed
+        std::condition_variable done_cv;
+        bool stopFlag = false;
+        int next_id = 0;
+        int running_id = -1;
+        int core = -1;
+        std::map<int, task_entry> tasks;
+        std::priority_queue<std::pair<clock::time_point, int>, std::vector<std::pair<clock::time_point, int>>, std::greater<std::pair<clock::time_point, int>>> deadlines;
+
+        SamplerScheduler() = default;
+        /// @brief the scheduling loop run by the thread
+        void _run();
+        /// @brief pin the thread to the requested core
+        void _set_affinity();
+
+    public:
+        ~SamplerScheduler();
+        SamplerScheduler(const SamplerScheduler &) = delete;
+        SamplerScheduler &operator=(const SamplerScheduler &) = delete;
+        /// @brief get the scheduler of the process 
+        static SamplerScheduler &Get();
+        /// @brief add a task, which is first run immediately and then every period. 
+        /// Starts the scheduler thread if needed
+        /// @param func the task to run, which takes a single sample
+        /// @param period time between runs of the task
+        /// @return id of the task 
+        int Add(std::function<void()> func, clock::duration period);
+        /// @brief remove a task, waiting for it to finish if it is running, unless it is removed 
+        /// by a task, such as a sampler pausing itself, in which case it is not run again
+        /// @param id id of the task 
+        void Remove(int id);
+        /// @brief set the core on which the scheduler thread runs
+        /// @param _core core id, which must be in the affinity mask of the process. Negative values
+        /// count from the end of the affinity mask, so -1 is the last core of the mask
+        /// @return whether the core is in the affinity mask and the thread could be pinned
+        bool SetCore(int _core);
+        /// @brief get the core the scheduler thread is pinned to
+        /// @return core id or -1 if not pinned 
+        int GetCore() {return core;}
+        /// @brief get the number of tasks scheduled
+        int GetNumTasks();
+    };
+
+    /// @brief set the core on which the sampling thread shared by all samplers runs, 
+    /// allowing sampling to be kept off the cores used by compute threads
+    /// @param core core id in the affinity mask, negative values counting from the end of the mask 
+    /// @return whether the core could be used
+    bool SetSamplerCore(int core);
+
+    /// @brief name, unit and number of values per sample (e.g. one per device) of a sampled metric
+    struct metric_info {
+        std::string name;
+        std::string unit;
+        int width = 1;
+    };
+
+    /// @brief source of one or more sampled metrics. A sampler opens its sources when sampling 
+    /// starts, calls Sample every sample period from the sampling thread and closes them when 
+    /// sampling is paused. Sources can be added to any sampler with GeneralSampler::AddSource, 
+    /// their samples being stored and reported like those of the built in metrics
+    class MetricSource {
+    public:
+        /// function storing a sample of the metric of the given index, taken at a time in seconds since 
+        /// the creation of the sampler, with the width values of the metric
+        using store_func = std::function<void(size_t metric, double time, const double *values)>;
+    protected:
+        std::vector<metric_info> metrics;
+    public:
+        MetricSource(std::vector<metric_info> _metrics = {}) : metrics(std::move(_metrics)) {}
+        virtual ~MetricSource() = default;
+        /// @return the metrics produced by the source 
+        const std::vector<metric_info> &GetMetrics() const {return metrics;}
+        /// @brief prepare the source for sampling, e.g. launching a monitor command
+        /// @return whether the source could be opened
+        virtual bool Open() {return true;}
+        /// @brief take samples of the metrics, calling store for each. A source may store no
+        /// sample, e.g. when no new data is available, or several 
+        /// @param time time of the sample in seconds since the creation of the sampler
+        /// @param store function storing a sample
+        virtual void Sample(double time, const store_func &store) = 0;
+        /// @brief release what was needed for sampling
+        virtual void Close() {}
+    };
+
+    /// @brief metric sampled by calling a function in process, e.g. an application queue depth
+    class FunctionSource: public MetricSource {
+    protected:
+        std::function<double()> func;
+    public:
+        FunctionSource(const std::string &name, const std::string &unit, std::function<double()> _func);
+        void Sample(double time, const store_func &store) override;
+    };
+
+    /// @brief CPU usage in % of the process, the cpu time used since the previous sample 
+    /// relative to the wall time elapsed, read in process from the process cpu time clock
+    class CPUUsageSource: public MetricSource {
+    protected:
+        std::chrono::steady_clock::time_point prior_when;
+        double prior_cputime = 0;
+        /// @return cpu time of the process in seconds
+        static double _get_process_cpu_time();
+    public:
+        CPUUsageSource(const std::string &name);
+        bool Open() override;
+        void Sample(double time, const store_func &store) override;
+    };
+
+    /// @brief metric sampled by running a command, each line of its output being one of the values. 
+    /// The command runs in the background so that a slow command does not hold up the other samplers: 
+    /// a sample launches it and a later sample stores its output, at the time it was launched. 
+    /// A sample made while the command is still running is skipped and counted as an overrun
+    class CommandSource: public MetricSource {
+    protected:
+        std::string cmd;
+        pid_t pid = -1;
+        int fd = -1;
+        /// output of the running command and the time at which it was launched
+        std::string output;
+        double run_time = 0;
+        std::atomic<std::size_t> noverruns{0};
+        /// @brief read the output of the running command without blocking 
+        /// @return whether the command has finished
+        bool _poll();
+        void _store_output(const store_func &store);
+    public:
+        CommandSource(const std::string &name, const std::string &unit, const std::string &_cmd, int width = 1);
+        ~CommandSource() {Close();}
+        void Sample(double time, const store_func &store) override;
+        void Close() override;
+        /// @return number of samples skipped as the command launched by an earlier sample was still running, 
+        /// when the sample period is shorter than the time the command takes
+        std::size_t GetNumOverruns() const {return noverruns;}
+    };
+
+    /// @brief metric read from the first number in a file, such as a counter in /sys, 
+    /// with the file kept open between samples
+    class FileSource: public MetricSource {
+    protected:
+        std::string path;
+        int fd = -1;
+    public:
+        FileSource(const std::string &name, const std::string &unit, const std::string &_path);
+        ~FileSource() {Close();}
+        bool Open() override;
+        void Sample(double time, const store_func &store) override;
+        void Close() override;
+    };
+
+    /// @brief metrics streamed by a long lived monitor command, each line holding comma separated 
+    /// values, one per metric, and a record being as many lines as the width of the metrics. 
+    /// Records that arrive between samples are assumed to be a period apart. A command that exits 
+    /// after streaming records is launched again
+    class MonitorStreamSource: public MetricSource {
+    protected:
+        std::string cmd;
+        double period;
+        pid_t pid = -1;
+        int fd = -1;
+        /// time of the last stored record
+        double last_time = 0;
+        /// whether records were streamed since the command was launched, and the number of times it exited
+        bool streamed = false;
+        std::size_t nexits = 0;
+        CSVStreamParser parser;
+    public:
+        /// @param _cmd command, which should print a record every period
+        /// @param _metrics metrics, one per column, all of the same width
+        /// @param _period period in seconds
+        MonitorStreamSource(const std::string &_cmd, std::vector<metric_info> _metrics, double _period);
+        ~MonitorStreamSource() {Close();}
+        bool Open() override;
+        void Sample(double time, const store_func &store) override;
+        void Close() override;
+    };
+
+    /// @brief IO rates of the process from /proc/self/io between samples, as three metrics: 
+    /// read and write calls per second, then read and write bandwidth in MiB/s, each with 
+    /// two values, the first counting all IO including that served by the page cache, 
+    /// the second only IO reaching the storage layer
+    class ProcIOSource: public MetricSource {
+    protected:
+        int fd = -1;
+        std::chrono::steady_clock::time_point prior_when;
+        io_counters prior;
+        io_counters _read();
+    public:
+        ProcIOSource(const std::string &ops_name, const std::string &read_name, const std::string &write_name);
+        ~ProcIOSource() {Close();}
+        bool Open() override;
+        void Sample(double time, const store_func &store) override;
+        void Close() override;
+    };
+
+    /// @brief memory usage of the process from /proc/self/status as two metrics: the RSS, VM and 
+    /// the anonymous, file backed and shared parts of the RSS in MiB, then the region the process 
+    /// was in when sampled, an index set by the owner of the source
+    class ProcMemorySource: public MetricSource {
+    protected:
+        std::shared_ptr<std::atomic<int>> region;
+    public:
+        ProcMemorySource(const std::string &mem_name, const std::string &region_name, std::shared_ptr<std::atomic<int>> _region);
+        void Sample(double time, const store_func &store) override;
+    };
+
+    /// @brief deterministic synthetic metric whose values are a function of the sample time, 
+    /// which allows the sampling and reporting to be tested without the hardware 
+    class SyntheticSource: public MetricSource {
+    protected:
+        std::function<void(double, double *)> func;
+    public:
+        /// @param func function setting the width values of the metric at a time in seconds
+        SyntheticSource(const std::string &name, const std::string &unit, int width, std::function<void(double time, double *values)> _func);
+        /// @param func function returning the value of the metric at a time in seconds
+        SyntheticSource(const std::string &name, const std::string &unit, std::function<double(double time)> _func);
+        void Sample(double time, const store_func &store) override;
+    };
+
+    /// @brief GeneralSampler class that samples metrics using the process wide SamplerScheduler and stores output
     /// inherents public routines from Timer
     class GeneralSampler: public profiling_util::Timer {
 
@@ -536,63 +1656,184 @@ namespace profiling_util {
         int id; 
         /// process id
         int pid = 0;
-        // time in seconds between samples
+        // time in micro seconds between samples
         float sample_time = 1.0;
-        std::vector<std::thread>* threads = nullptr;
-        std::mutex mtx;
-        std::condition_variable cv;
-        bool stopFlag = false;
+        /// steady reference time of the sample timestamps
+        std::chrono::steady_clock::time_point sample_t0;
+        /// long lived commands that are not periodic samples, with the files to which their output 
+        /// is appended, and their process ids while running
+        std::vector<std::string> long_lived_cmds, long_lived_fnames;
+        std::vector<pid_t> long_lived_pids;
+        /// sampled source with the buffers and export files of its metrics
+        struct source_state {
+            std::shared_ptr<MetricSource> source;
+            std::vector<SampleBuffer *> buffers;
+            std::vector<std::ofstream> outs;
+        };
+        std::vector<std::shared_ptr<source_state>> sources;
+        /// sampling tasks, each taking one sample, kept so that sampling can be restarted
+        std::vector<std::function<void()>> tasks;
+        /// ids of the tasks in the scheduler while sampling
+        std::vector<int> task_ids;
+        std::atomic<bool> stopFlag{false};
         bool use_device = true;
-        bool keep_files = false;
+        std::atomic<bool> keep_files{false};
+        /// in-memory store of samples of each metric, keyed by the name of the file
+        /// to which the samples are exported when keeping files, along with its unit
+        std::vector<std::string> buffer_names, buffer_units;
+        std::vector<std::unique_ptr<SampleBuffer>> buffers;
+#ifdef _MPI
+        /// communicator of the ranks on the node and shared memory window holding
+        /// the buffers of node level metrics, which only the node leader samples
+        MPI_Comm node_comm = MPI_COMM_NULL;
+        MPI_Win node_win = MPI_WIN_NULL;
+        int node_rank = 0;
+#endif
 
     protected:
-        std::string _set_sampling(const std::string &cmd, const std::string &out)
-        {
-            return std::string(cmd + " >> " + out);
-        }
-        /// @brief launches the sampling processes
+        /// @brief add a source whose metrics are stored in the given buffers and schedule its sampling
+        /// @param source the source
+        /// @param source_buffers buffers of each metric of the source
+        void _add_source(std::shared_ptr<MetricSource> source, std::vector<SampleBuffer *> source_buffers);
+        /// @brief add sources of node level metrics. If the sampler shares node metrics 
+        /// (see _set_node_comm), only the node leader samples the sources, storing samples 
+        /// in node shared memory that the other ranks on the node read. Otherwise like AddSource. 
+        /// Can only be called once
+        /// @param node_sources vector of sources
+        void _add_node_sources(const std::vector<std::shared_ptr<MetricSource>> &node_sources);
+        /// @brief make the buffers of node level metrics. If the sampler shares node metrics 
+        /// the buffers are in node shared memory, written by the node leader
+        /// @param metrics vector of the metrics
+        /// @return vector of buffers
+        std::vector<SampleBuffer *> _add_node_buffers(const std::vector<metric_info> &metrics);
+#ifdef _MPI
+        /// @brief share node level metrics between ranks of a communicator on the same node.
+        /// Collective on comm 
+        /// @param comm communicator 
+        void _set_node_comm(MPI_Comm &comm);
+#endif
+        /// @brief launches long lived commands whose output is directly appended to files rather than stored in memory.
+        /// The commands run until sampling is paused
         /// @param requests vector of strings containing commands to run
         /// @param fnames vector of strings containing file names to which to save the output
-        void _launch(std::vector<std::string> requests = {}, std::vector<std::string> fnames = {});
-
-        /// @brief Place a command using std::system and threads 
-        /// @param cmd command to place 
-        void _place_cmd(const std::string cmd)
+        void _launch_to_file(std::vector<std::string> requests, std::vector<std::string> fnames);
+        /// @brief spawn the long lived commands and open the sources
+        void _spawn_long_lived();
+        /// @brief stop the long lived commands, waiting for them to exit, and close the sources
+        void _stop_long_lived();
+
+        /// @brief add a sampling task and schedule it every sample_time
+        /// @param task the task taking a single sample
+        void _add_task(std::function<void()> task);
+
+        /// @brief get the time at which a sample is taken 
+        /// @return time in seconds since the creation of the sampler 
+        inline double _get_sample_time() const
         {
-            std::system(cmd.c_str());
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - sample_t0).count();
         }
 
-        /// @brief Place a command using std::system and threads 
+        /// @brief make the buffer storing samples of a metric 
+        /// @param metric name, used as the file name when exporting, unit and width of the metric
+        /// @return pointer to buffer
+        SampleBuffer *_add_buffer(const metric_info &metric);
+
+        /// @brief store sample in buffer and, if keeping files, also export it to file
+        /// @param buffer buffer storing samples
+        /// @param time time at which the sample was taken
+        /// @param vals values to store, must contain the buffer's width values
+        /// @param out stream of the export file, opened when first needed
+        /// @param fname name of the export file
+        void _store_sample(SampleBuffer *buffer, double time, const double *vals, std::ofstream &out, const std::string &fname);
+
+        /// @brief Place a command, waiting for it to finish
         /// @param cmd command to place 
-        /// @param sleep_time time to sleep between running command
-        void _place_long_lived_cmd(const std::string cmd, float sleep_time)
+        void _place_cmd(const std::string cmd)
         {
-            while (!stopFlag) 
-            {
-                std::system(cmd.c_str());
-                std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int>(sleep_time)));
-            }
+            wait_cmd(spawn_cmd(cmd));
         }
 
+        /// @brief Take samples of a source and store them 
+        /// @param state the source with its buffers 
+        void _sample_source(std::shared_ptr<source_state> state);
+
     public:
         GeneralSampler(const std::string &f, const std::string &F, const std::string &l, float samples_per_sec = 1.0, bool _use_device=true, bool _keep_files = false);
+        /// @brief pauses sampling. Derived samplers whose sampling tasks use their own members 
+        /// must pause first in their destructors, as those members are destroyed before this runs
         ~GeneralSampler();
-        /// @brief pauses the sampling by joining threads
+        /// @brief pauses the sampling by removing its tasks from the scheduler. Not needed for reporting,
+        /// reports take a snapshot of the samples while sampling continues 
         void Pause();
-        /// @brief restart the sampling by launching threads
+        /// @brief restart the sampling by scheduling its tasks again, appending to the existing samples
         void Restart();
         /// @brief get sample time 
-        /// @return sample time
+        /// @return sample time in micro seconds
         float GetSampleTime(){return sample_time;}
-        /// @brief indicate whether to keep files used for sampling 
+        /// @brief get the names of the metrics sampled in memory
+        /// @return vector of metric names, which are the names of the files they are exported to
+        std::vector<std::string> GetMetricNames(){return buffer_names;}
+        /// @brief get the unit of a metric
+        /// @param name the name of the metric
+        /// @return unit, empty if the metric is not found
+        std::string GetMetricUnit(const std::string &name);
+        /// @brief indicate whether to export samples to files 
         /// @param _keep_files bool whether to keep files
         void SetKeepFiles(bool _keep_files){keep_files = _keep_files;};
         /// @brief get whether keeping files  
         /// @return bool of keeping files 
         bool GetKeepFiles(){return keep_files;}
+        /// @brief get whether this process samples node level metrics, which is 
+        /// false for ranks other than the node leader of samplers sharing node metrics
+        /// @return bool of whether sampling node metrics
+        bool GetIsNodeSampler()
+        {
+#ifdef _MPI
+            return node_rank == 0;
+#else 
+            return true;
+#endif
+        }
 
-        /// @brief read the data from a file and returnt the vector of sampling data
-        /// @param fname the string of the file name to open
+        /// @brief add a source of metrics, sampled every sample period like the built in metrics, 
+        /// and reported with ReportMetric
+        /// @param source the source
+        void AddSource(std::shared_ptr<MetricSource> source);
+#ifdef _MPI
+        /// @brief add sources of node level metrics shared between the ranks of a communicator on the 
+        /// same node. Only the node leader samples the sources and the other ranks read its samples.
+        /// Collective on comm. Can only be called once, and not on samplers already sharing node metrics
+        /// such as a ComputeSampler constructed with a communicator
+        /// @param comm communicator 
+        /// @param node_sources vector of sources
+        void AddNodeSources(MPI_Comm &comm, const std::vector<std::shared_ptr<MetricSource>> &node_sources);
+#endif
+
+        /// @brief sample metrics from a long lived monitor command instead of running a command per sample.
+        /// Each line the command prints holds comma separated values, one per metric, and every nrows lines 
+        /// make a sample. For example nvidia-smi --query-gpu=power.draw,utilization.gpu --format=csv,noheader,nounits --loop-ms=100
+        /// @param cmd command, which should print a record every sample period
+        /// @param fnames names of the metrics, one per column, which are the names of the files they are exported to
+        /// @param nrows number of lines per sample, e.g. the number of devices
+        void AddMonitorStream(const std::string &cmd, const std::vector<std::string> &fnames, int nrows = 1);
+
+        /// @brief get a snapshot of the samples of a metric without stopping sampling
+        /// @param fname the name of the metric (the file name it is exported to)
+        /// @param times vector of the time of each sample in seconds since creation of sampler
+        /// @param values vector of the values of each sample
+        /// @return whether metric was found
+        bool GetSamples(const std::string &fname, std::vector<double> &times, std::vector<double> &values);
+
+        /// @brief get the running totals of a metric over all its samples, which unlike a snapshot of
+        /// the samples are not limited to the samples retained in memory
+        /// @param fname the name of the metric (the file name it is exported to)
+        /// @param totals running totals
+        /// @return whether metric was found
+        bool GetTotals(const std::string &fname, sample_totals &totals);
+
+        /// @brief return the vector of sampling data of a metric. If the metric is not
+        /// sampled in memory, the data is read from the file 
+        /// @param fname the name of the metric, which is the file name it is exported to
         /// @return vector of data
         std::vector<double> GetSamplingData(const std::string &fname);
 
@@ -612,8 +1853,17 @@ namespace profiling_util {
 #ifdef _CRAY_ENERGY_COUNTERS
         std::string cray_node_energy_fname;
 #endif
+        /// @brief set up the file names and launch the sampling 
+        void _setup();
     public:
         ComputeSampler(const std::string &f, const std::string &F, const std::string &l, float samples_per_sec = 1.0, bool _use_device=true, bool _keep_files=false);
+#ifdef _MPI
+        /// @brief make a sampler whose node level metrics (GPU, node energy) are sampled once per node 
+        /// by the node leader of comm and shared with the other ranks on the node through shared memory,
+        /// while per process metrics (CPU usage) are sampled locally. Collective on comm, as is 
+        /// the destruction of the sampler.
+        ComputeSampler(const std::string &f, const std::string &F, const std::string &l, MPI_Comm &comm, float samples_per_sec = 1.0, bool _use_device=true, bool _keep_files=false);
+#endif
         ~ComputeSampler();
         /// @brief get file name store cpu usage info
         /// @return filename
@@ -654,6 +1904,24 @@ namespace profiling_util {
     /// @return string of CPU usage statistics
     std::string ReportCPUUsage(ComputeSampler &s, const std::string &f, const std::string &F, const std::string &l);
 
+    /// @brief reports the achieved sampling rate and the jitter of the sampling intervals of all metrics of a sampler
+    /// @param s sampler to use for reporting 
+    /// @param f function where called in code, useful to provide __func__ 
+    /// @param F function where called in code, useful to provide __FILE__ 
+    /// @param l code line number where called
+    /// @return string of sampling rate and interval statistics
+    std::string ReportSamplerTiming(GeneralSampler &s, const std::string &f, const std::string &F, const std::string &l);
+
+    /// @brief report the statistics of a sampled metric, such as one of a source added with AddSource. 
+    /// Metrics with several values per sample are reported per value
+    /// @param s sampler 
+    /// @param name name of the metric
+    /// @param f function where called in code, useful to provide __func__ 
+    /// @param F function where called in code, useful to provide __FILE__ 
+    /// @param l code line number where called
+    /// @return string of metric statistics
+    std::string ReportMetric(GeneralSampler &s, const std::string &name, const std::string &f, const std::string &F, const std::string &l);
+
 #ifdef _GPU
     /// @brief reports the statistics of GPU usage from start to current line
     /// @param s sampler to use for reporting 
@@ -703,11 +1971,22 @@ namespace profiling_util {
     /// @return string of node energy
     std::string ReportCrayNodeEnergy(ComputeSampler &s, const std::string &f, const std::string &F, const std::string &l);
 #endif
-    class IOSampler: protected profiling_util::GeneralSampler {
+    /// @brief IOSampler class that samples the IO rates of the process from /proc/self/io
+    /// from point of creation to requested reporting, distinguishing all IO, including that
+    /// served by the page cache, from IO reaching storage.
+    /// inherents public routines from Timer
+    class IOSampler: public profiling_util::GeneralSampler {
 
     private:
         std::string io_ops_fname, io_read_fname, io_write_fname;
+        /// counters at creation
+        io_counters start;
     public:
+        IOSampler(const std::string &f, const std::string &F, const std::string &l, float samples_per_sec = 1.0, bool _keep_files=false);
+        ~IOSampler();
+        /// @brief get the IO counters at the creation of the sampler
+        /// @return counters
+        io_counters GetStartCounters(){return start;}
         /// @brief get file name store io ops info
         /// @return filename
         std::string GetIOStatsFname(){return io_ops_fname;}
@@ -719,14 +1998,95 @@ namespace profiling_util {
         std::string GetIOWriteFname(){return io_write_fname;}
     };
 
-    /// @brief reports the statistics of IO from start to current line
+    /// @brief reports the statistics of the read and write bandwidth and IO calls per second 
+    /// from start to current line, for all IO and for IO reaching storage, along with the totals. 
+    /// The maximum is the peak rate over a sample period 
     /// @param s sampler to use for reporting 
     /// @param f function where called in code, useful to provide __func__ 
     /// @param F function where called in code, useful to provide __FILE__ 
     /// @param l code line number where called
-    /// @return string of CPU usage statistics
+    /// @return string of IO statistics
     std::string ReportIOStats(IOSampler &s, const std::string &f, const std::string &F, const std::string &l);
 
+    /// @brief MemorySampler class that samples the memory usage of the process from /proc/self/status
+    /// from point of creation to requested reporting. Each sample is tagged with the region being 
+    /// executed, the reference of the active Timer, so that peaks can be attributed to code regions. 
+    /// inherents public routines from Timer
+    class MemorySampler: public profiling_util::GeneralSampler {
+
+    private:
+        std::string mem_fname, mem_region_fname;
+        /// index in regions of the active region, 0 being the sampler itself
+        std::shared_ptr<std::atomic<int>> region;
+        std::vector<std::string> regions;
+        std::mutex regions_mtx;
+    public:
+        MemorySampler(const std::string &f, const std::string &F, const std::string &l, float samples_per_sec = 0.01, bool _keep_files=false);
+        ~MemorySampler();
+        /// @brief tag the following samples with the reference of a timer (see Timer::get_ref), 
+        /// which marks the region being executed
+        /// @param t timer of the region
+        void SetActiveTimer(const Timer &t);
+        /// @brief tag the following samples with the reference of the sampler
+        void ClearActiveTimer(){*region = 0;}
+        /// @brief get the references of the regions
+        /// @return vector of references, indexed by the region stored with each sample
+        std::vector<std::string> GetRegions();
+        /// @brief get file name store memory usage info
+        /// @return filename
+        std::string GetMemFname(){return mem_fname;}
+        /// @brief get file name store the region of each memory sample
+        /// @return filename
+        std::string GetMemRegionFname(){return mem_region_fname;}
+    };
+
+    /// @brief reports the statistics of the memory usage from start to current line, with the peak 
+    /// of each kind of memory, when and in which region it occurred, and growth rates. 
+    /// Peaks are those of the samples still retained by the sampler
+    /// @param s sampler to use for reporting 
+    /// @param f function where called in code, useful to provide __func__ 
+    /// @param F function where called in code, useful to provide __FILE__ 
+    /// @param l code line number where called
+    /// @return string of memory statistics
+    std::string ReportMemoryPeaks(MemorySampler &s, const std::string &f, const std::string &F, const std::string &l);
+
+    /// @brief MemoryScope class measuring the peak RSS of a region of code rather than the lifetime 
+    /// peak of the process, so the peak of a phase is visible after an earlier larger phase. 
+    /// On creation, the peak RSS of the kernel (VmHWM) is reset by writing 5 to /proc/self/clear_refs. 
+    /// Where that is not permitted, the RSS is instead sampled, which can miss short lived peaks. 
+    /// Peaks lost to a reset are kept so enclosing scopes and get_memory_usage still report them 
+    class MemoryScope {
+
+    private:
+        memory_usage start;
+        bool peak_reset = false;
+        /// largest peak RSS of the process at the creation of enclosed scopes
+        std::size_t folded_peak = 0;
+        std::unique_ptr<GeneralSampler> sampler;
+        /// scopes alive, whose peaks are updated when a scope resets the peak
+        static std::mutex scopes_mtx;
+        static std::vector<MemoryScope *> scopes;
+    public:
+        MemoryScope(const std::string &f, const std::string &F, const std::string &l, float sample_time = 0.01);
+        ~MemoryScope();
+        MemoryScope(const MemoryScope &) = delete;
+        MemoryScope &operator=(const MemoryScope &) = delete;
+        /// @brief get the memory usage at creation of the scope
+        /// @return memory usage
+        memory_usage GetStart(){return start;}
+        /// @brief get whether the peak RSS was reset rather than sampled
+        /// @return bool of whether reset
+        bool GetPeakReset(){return peak_reset;}
+        /// @brief get the current memory usage, with the change since the creation of the scope and
+        /// the peak RSS since then. The VM peak remains that of the lifetime of the process
+        /// @return memory usage
+        memory_usage GetUsage();
+    };
+    /// report memory usage with the change and peak RSS since the start of a scope
+    std::string ReportMemUsage(MemoryScope &scope, const std::string &f, const std::string &F, const std::string &l);
+    /// like ReportMemUsage but also returns the mem usage 
+    std::tuple<std::string, memory_usage> GetMemUsage(MemoryScope &scope, const std::string &f, const std::string &F, const std::string &l);
+
     /// @brief ComputeSample class that gets the stats of utilisation/energy
     /// from point of creation to requested reporting.
     /// inherents public routines from Timer
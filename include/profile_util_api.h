@@ -7,7 +7,11 @@
 
 /// \def logger utility definitions 
 //@{
-#define _where_calling_from "@"<<__func__<<" "<<profiling_util::__extract_filename(__FILE__)<<":L"<<std::to_string(__LINE__)<<" "
+/// name of the file without its directories, found at compile time
+#define _PU_FILE (__FILE__ + std::integral_constant<std::size_t, profiling_util::__filename_offset(__FILE__)>::value)
+/// location of the call site, made without allocating
+#define _PU_HERE profiling_util::source_location{__func__, _PU_FILE, __LINE__}
+#define _where_calling_from _PU_HERE<<" "
 #define _when_calling_from "("<<profiling_util::__when()<<") : "
 #ifdef _MPI 
 #define _MPI_calling_rank "["<<std::setw(5) << std::setfill('0')<<profiling_util::__comm_rank<<"] "<<std::setw(0)
@@ -51,13 +55,13 @@
 //@{
 #define LogParallelAPI() Log()<<"\n"<<profiling_util::ReportParallelAPI()<<std::endl;
 #define LogBinding() Log()<<"\n"<<profiling_util::ReportBinding()<<std::endl;
-#define LogThreadAffinity() {auto __s = profiling_util::ReportThreadAffinity(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__)); Log()<<__s;}
-#define LoggerThreadAffinity(logger) {auto __s = <<profiling_util::ReportThreadAffinity(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__)); Logger(logger)<<__s;}
+#define LogThreadAffinity() {auto __s = profiling_util::ReportThreadAffinity(__func__, _PU_FILE, std::to_string(__LINE__)); Log()<<__s;}
+#define LoggerThreadAffinity(logger) {auto __s = <<profiling_util::ReportThreadAffinity(__func__, _PU_FILE, std::to_string(__LINE__)); Logger(logger)<<__s;}
 #ifdef _MPI
 #define MPILog0ThreadAffinity() if(profiling_util::__comm_rank == 0) LogThreadAffinity();
 #define MPILogger0ThreadAffinity(logger) if(profiling_util::__comm_rank == 0) LogThreadAffinity(logger);
-#define MPILogThreadAffinity() {auto __s = profiling_util::MPIReportThreadAffinity(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__),  profiling_util::__comm); Log()<<__s;}
-#define MPILoggerThreadAffinity(logger) {auto __s = profiling_util::MPIReportThreadAffinity(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), profiling_util::__comm); Logger(logger)<<__s;}
+#define MPILogThreadAffinity() {auto __s = profiling_util::MPIReportThreadAffinity(__func__, _PU_FILE, std::to_string(__LINE__),  profiling_util::__comm); Log()<<__s;}
+#define MPILoggerThreadAffinity(logger) {auto __s = profiling_util::MPIReportThreadAffinity(__func__, _PU_FILE, std::to_string(__LINE__), profiling_util::__comm); Logger(logger)<<__s;}
 #define MPILog0ParallelAPI() if(profiling_util::__comm_rank == 0) Log()<<"\n"<<profiling_util::ReportParallelAPI()<<std::endl;
 #define MPILog0Binding() {auto s = profiling_util::ReportBinding(); if (profiling_util::__comm_rank == 0)Log()<<"\n"<<s<<std::endl;}
 #endif
@@ -66,24 +70,39 @@
 /// \defgroup LogMem
 /// Log memory usage either to std or an ostream
 //@{
-#define LogMemUsage() Log()<<profiling_util::ReportMemUsage(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerMemUsage(logger) Logger(logger)<<profiling_util::ReportMemUsage(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define LogMemUsage() Log()<<profiling_util::ReportMemUsage(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerMemUsage(logger) Logger(logger)<<profiling_util::ReportMemUsage(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define NewMemoryScope() profiling_util::MemoryScope(__func__, _PU_FILE, std::to_string(__LINE__));
+#define LogScopeMemUsage(scope) Log()<<profiling_util::ReportMemUsage(scope, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerScopeMemUsage(logger,scope) Logger(logger)<<profiling_util::ReportMemUsage(scope, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogHeapStats() Log()<<profiling_util::ReportHeapStats(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerHeapStats(logger) Logger(logger)<<profiling_util::ReportHeapStats(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogHeapStatsPerIteration(prior,niterations) Log()<<profiling_util::ReportHeapStats(prior, niterations, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerHeapStatsPerIteration(logger,prior,niterations) Logger(logger)<<profiling_util::ReportHeapStats(prior, niterations, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogHeapState() Log()<<profiling_util::ReportHeapState(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerHeapState(logger) Logger(logger)<<profiling_util::ReportHeapState(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogHeapTrim() Log()<<profiling_util::ReportHeapState(__func__, _PU_FILE, std::to_string(__LINE__), true)<<std::endl;
+#define LoggerHeapTrim(logger) Logger(logger)<<profiling_util::ReportHeapState(__func__, _PU_FILE, std::to_string(__LINE__), true)<<std::endl;
+#define LogNUMAPlacement(ptr,bytes) Log()<<profiling_util::ReportNUMAPlacement(ptr, bytes, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerNUMAPlacement(logger,ptr,bytes) Logger(logger)<<profiling_util::ReportNUMAPlacement(ptr, bytes, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
 
 #ifdef _MPI
-#define MPILogMemUsage() Log()<<profiling_util::ReportMemUsage(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILoggerMemUsage(logger) Logger(logger)<<profiling_util::ReportMemUsage(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILog0NodeMemUsage() {auto __s=profiling_util::MPIReportNodeMemUsage(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__)); if (profiling_util::__comm_rank == 0) {Log()<<__s<<std::endl;}}
-#define MPILogger0NodeMemUsage(logger) {auto __s=profiling_util::MPIReportNodeMemUsage(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__)); int __comm_rank; if (profiling_util::__comm_rank == 0) {Logger(logger)<<__s<<std::endl;}}
+#define MPILogMemUsage() Log()<<profiling_util::ReportMemUsage(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define MPILoggerMemUsage(logger) Logger(logger)<<profiling_util::ReportMemUsage(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define MPILog0NodeMemUsage() {auto __s=profiling_util::MPIReportNodeMemUsage(profiling_util::__comm, __func__, _PU_FILE, std::to_string(__LINE__)); if (profiling_util::__comm_rank == 0) {Log()<<__s<<std::endl;}}
+#define MPILogger0NodeMemUsage(logger) {auto __s=profiling_util::MPIReportNodeMemUsage(profiling_util::__comm, __func__, _PU_FILE, std::to_string(__LINE__)); int __comm_rank; if (profiling_util::__comm_rank == 0) {Logger(logger)<<__s<<std::endl;}}
+#define MPILog0NodeMemUsageSummary() {auto __s=profiling_util::MPIReportNodeMemUsageSummary(profiling_util::__comm, __func__, _PU_FILE, std::to_string(__LINE__)); if (profiling_util::__comm_rank == 0) {Log()<<__s<<std::endl;}}
+#define MPILogger0NodeMemUsageSummary(logger) {auto __s=profiling_util::MPIReportNodeMemUsageSummary(profiling_util::__comm, __func__, _PU_FILE, std::to_string(__LINE__)); if (profiling_util::__comm_rank == 0) {Logger(logger)<<__s<<std::endl;}}
 #endif
 
-#define LogSystemMem() std::cout<<profiling_util::ReportSystemMem(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerSystemMem(logger) logger<<profiling_util::ReportSystemMem(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define LogSystemMem() std::cout<<profiling_util::ReportSystemMem(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerSystemMem(logger) logger<<profiling_util::ReportSystemMem(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
 
 #ifdef _MPI
-#define MPILogSystemMem() Log()<<profiling_util::ReportSystemMem(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILoggerSystemMem(logger) Logger(logger)<<profiling_util::ReportSystemMem(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILog0NodeSystemMem() {auto __s=profiling_util::MPIReportNodeSystemMem(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__));if (profiling_util::__comm_rank == 0){Log()<<__s<<std::endl;}}
-#define MPILogger0NodeSystemMem(logger) {auto __s = profiling_util::MPIReportNodeSystemMem(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__));if (profiling_util::__comm_rank == 0) {Logger(logger)<<__s<<std::endl;}}
+#define MPILogSystemMem() Log()<<profiling_util::ReportSystemMem(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define MPILoggerSystemMem(logger) Logger(logger)<<profiling_util::ReportSystemMem(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define MPILog0NodeSystemMem() {auto __s=profiling_util::MPIReportNodeSystemMem(profiling_util::__comm, __func__, _PU_FILE, std::to_string(__LINE__));if (profiling_util::__comm_rank == 0){Log()<<__s<<std::endl;}}
+#define MPILogger0NodeSystemMem(logger) {auto __s = profiling_util::MPIReportNodeSystemMem(profiling_util::__comm, __func__, _PU_FILE, std::to_string(__LINE__));if (profiling_util::__comm_rank == 0) {Logger(logger)<<__s<<std::endl;}}
 #endif
 //@}
 
@@ -91,54 +110,87 @@
 /// \defgroup LogTime
 /// Log time taken either to std or an ostream
 //@{
-#define LogTimeTaken(timer) Log()<<profiling_util::ReportTimeTaken(timer, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerTimeTaken(logger,timer) Logger(logger)<<profiling_util::ReportTimeTaken(timer,__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LogTimeTakenOnDevice(timer) Log()<<profiling_util::ReportTimeTakenOnDevice(timer, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerTimeTakenOnDevice(logger,timer) Logger(logger)<<profiling_util::ReportTimeTakenOnDevice(timer,__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define LogTimeTaken(timer) Log()<<profiling_util::ReportTimeTaken(timer, _PU_HERE)<<std::endl;
+#define LoggerTimeTaken(logger,timer) Logger(logger)<<profiling_util::ReportTimeTaken(timer, _PU_HERE)<<std::endl;
+#define LogTimeTakenOnDevice(timer) Log()<<profiling_util::ReportTimeTakenOnDevice(timer, _PU_HERE)<<std::endl;
+#define LoggerTimeTakenOnDevice(logger,timer) Logger(logger)<<profiling_util::ReportTimeTakenOnDevice(timer, _PU_HERE)<<std::endl;
 #ifdef _MPI
-#define MPILogTimeTaken(timer) Log()<<profiling_util::ReportTimeTaken(timer, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILoggerTimeTaken(logger,timer) Logger(logger)<<profiling_util::ReportTimeTaken(timer,__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILogTimeTakenOnDevice(timer) Log()<<profiling_util::ReportTimeTakenOnDevice(timer, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILoggerTimeTakenOnDevice(logger,timer) Logger(logger)<<profiling_util::ReportTimeTakenOnDevice(timer,__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define MPILogTimeTaken(timer) Log()<<profiling_util::ReportTimeTaken(timer, _PU_HERE)<<std::endl;
+#define MPILoggerTimeTaken(logger,timer) Logger(logger)<<profiling_util::ReportTimeTaken(timer, _PU_HERE)<<std::endl;
+#define MPILogTimeTakenOnDevice(timer) Log()<<profiling_util::ReportTimeTakenOnDevice(timer, _PU_HERE)<<std::endl;
+#define MPILoggerTimeTakenOnDevice(logger,timer) Logger(logger)<<profiling_util::ReportTimeTakenOnDevice(timer, _PU_HERE)<<std::endl;
 #endif 
-#define NewTimer() profiling_util::Timer(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__));
-#define NewTimerHostOnly() profiling_util::Timer(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), false);
+#define LogLaps(timer) Log()<<profiling_util::ReportLaps(timer, _PU_HERE)<<std::endl;
+#define LoggerLaps(logger,timer) Logger(logger)<<profiling_util::ReportLaps(timer, _PU_HERE)<<std::endl;
+#define NewTimer() profiling_util::Timer(_PU_HERE);
+#define NewTimerHostOnly() profiling_util::Timer(_PU_HERE, false);
 
-#define NewSampler(t) profiling_util::StateSampler(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), true, t);
-#define NewSamplerHostOnly(t) profiling_util::StateSampler(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), false, t);
+#define NewSampler(t) profiling_util::StateSampler(__func__, _PU_FILE, std::to_string(__LINE__), true, t);
+#define NewSamplerHostOnly(t) profiling_util::StateSampler(__func__, _PU_FILE, std::to_string(__LINE__), false, t);
+//@}
+
+/// \defgroup Regions
+/// Scoped regions accumulated in a call tree per thread, reported at the end of a scope or at program exit
+//@{
+#define _PU_CONCAT_IMPL(a,b) a##b
+#define _PU_CONCAT(a,b) _PU_CONCAT_IMPL(a,b)
+#define _PU_REGION_ID _PU_CONCAT(__pu_region_,__LINE__)
+#define PU_REGION(name) static const int _PU_REGION_ID = profiling_util::RegisterRegion(name, _PU_HERE); profiling_util::RegionScope _PU_CONCAT(__pu_region_scope_,__LINE__)(_PU_REGION_ID);
+#define PU_REGION_REPORT(name) static const int _PU_REGION_ID = profiling_util::RegisterRegion(name, _PU_HERE); profiling_util::RegionReportScope _PU_CONCAT(__pu_region_scope_,__LINE__)(_PU_REGION_ID, _PU_HERE);
+#define LogRegions() Log()<<profiling_util::ReportRegions(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerRegions(logger) Logger(logger)<<profiling_util::ReportRegions(__func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogTimerOverhead() Log()<<"\n"<<profiling_util::ReportTimerOverhead()<<std::endl;
+#define LoggerTimerOverhead(logger) Logger(logger)<<"\n"<<profiling_util::ReportTimerOverhead()<<std::endl;
 //@}
 
 /// \defgroup LogUsage
 /// Log usage statistics either to std or an ostream
 //@{
-#define LogCPUUsage(sampler) Log()<<profiling_util::ReportCPUUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerCPUUsage(logger,timer) Logger(logger)<<profiling_util::ReportCPUUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define LogCPUUsage(sampler) Log()<<profiling_util::ReportCPUUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerCPUUsage(logger,timer) Logger(logger)<<profiling_util::ReportCPUUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
 #ifdef _MPI
-#define MPILogCPUUsage(sampler) Log()<<profiling_util::ReportCPUUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define MPILoggerCPUUsage(logger,timer) Logger(logger)<<profiling_util::profiling_util::ReportCPUUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define MPILogCPUUsage(sampler) Log()<<profiling_util::ReportCPUUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define MPILoggerCPUUsage(logger,timer) Logger(logger)<<profiling_util::profiling_util::ReportCPUUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define MPILoggerSamplerTiming(logger,sampler) Logger(logger)<<profiling_util::ReportSamplerTiming(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
 #endif 
 
+#define LogSamplerTiming(sampler) Log()<<profiling_util::ReportSamplerTiming(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerSamplerTiming(logger,sampler) Logger(logger)<<profiling_util::ReportSamplerTiming(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogIOStats(sampler) Log()<<profiling_util::ReportIOStats(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerIOStats(logger,sampler) Logger(logger)<<profiling_util::ReportIOStats(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogMemoryPeaks(sampler) Log()<<profiling_util::ReportMemoryPeaks(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerMemoryPeaks(logger,sampler) Logger(logger)<<profiling_util::ReportMemoryPeaks(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogMetric(sampler,name) Log()<<profiling_util::ReportMetric(sampler, name, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerMetric(logger,sampler,name) Logger(logger)<<profiling_util::ReportMetric(sampler, name, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+
 #ifdef _GPU
-#define LogGPUUsage(sampler) Log()<<profiling_util::ReportGPUUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerGPUUsage(logger,sampler) Logger(logger)<<profiling_util::ReportGPUUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LogGPUEnergy(sampler) Log()<<profiling_util::ReportGPUEnergy(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerGPUEnergy(logger,sampler) Logger(logger)<<profiling_util::ReportGPUEnergy(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LogGPUMem(sampler) Log()<<profiling_util::ReportGPUMem(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerGPUMem(logger,sampler) Logger(logger)<<profiling_util::ReportGPUMem(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LogGPUMemUsage(sampler) Log()<<profiling_util::ReportGPUMemUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerGPUMemUsage(logger,sampler) Logger(logger)<<profiling_util::ReportGPUMemUsage(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LogGPUStatistics(sampler) Log()<<profiling_util::ReportGPUStatistics(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerGPUStatistics(logger,sampler) Logger(logger)<<profiling_util::ReportGPUStatistics(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define LogGPUUsage(sampler) Log()<<profiling_util::ReportGPUUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerGPUUsage(logger,sampler) Logger(logger)<<profiling_util::ReportGPUUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogGPUEnergy(sampler) Log()<<profiling_util::ReportGPUEnergy(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerGPUEnergy(logger,sampler) Logger(logger)<<profiling_util::ReportGPUEnergy(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogGPUMem(sampler) Log()<<profiling_util::ReportGPUMem(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerGPUMem(logger,sampler) Logger(logger)<<profiling_util::ReportGPUMem(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogGPUMemUsage(sampler) Log()<<profiling_util::ReportGPUMemUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerGPUMemUsage(logger,sampler) Logger(logger)<<profiling_util::ReportGPUMemUsage(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LogGPUStatistics(sampler) Log()<<profiling_util::ReportGPUStatistics(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerGPUStatistics(logger,sampler) Logger(logger)<<profiling_util::ReportGPUStatistics(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
 #endif
 #ifdef _CRAY_ENERGY_COUNTERS
-#define LogCrayNodeEnergy(sampler) Log()<<profiling_util::ReportCrayNodeEnergy(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
-#define LoggerCrayNodeEnergy(logger,sampler) Logger(logger)<<profiling_util::ReportCrayNodeEnergy(sampler, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__))<<std::endl;
+#define LogCrayNodeEnergy(sampler) Log()<<profiling_util::ReportCrayNodeEnergy(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
+#define LoggerCrayNodeEnergy(logger,sampler) Logger(logger)<<profiling_util::ReportCrayNodeEnergy(sampler, __func__, _PU_FILE, std::to_string(__LINE__))<<std::endl;
 #endif
 
-#define NewComputeSampler(t) profiling_util::ComputeSampler(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), t, true);
-#define NewComputeSamplerHostOnly(t) profiling_util::ComputeSampler(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), t, false);
+#define NewGeneralSampler(t) profiling_util::GeneralSampler(__func__, _PU_FILE, std::to_string(__LINE__), t, true);
+#define NewComputeSampler(t) profiling_util::ComputeSampler(__func__, _PU_FILE, std::to_string(__LINE__), t, true);
+#define NewComputeSamplerHostOnly(t) profiling_util::ComputeSampler(__func__, _PU_FILE, std::to_string(__LINE__), t, false);
+#ifdef _MPI
+#define MPINewNodeComputeSampler(t) profiling_util::ComputeSampler(__func__, _PU_FILE, std::to_string(__LINE__), profiling_util::__comm, t, true);
+#define MPINewNodeComputeSamplerHostOnly(t) profiling_util::ComputeSampler(__func__, _PU_FILE, std::to_string(__LINE__), profiling_util::__comm, t, false);
+#endif
 
-#define NewSTraceSampler(t) profiling_util::STraceSampler(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), t, true);
+#define NewIOSampler(t) profiling_util::IOSampler(__func__, _PU_FILE, std::to_string(__LINE__), t);
+#define NewMemorySampler(t) profiling_util::MemorySampler(__func__, _PU_FILE, std::to_string(__LINE__), t);
+#define NewSTraceSampler(t) profiling_util::STraceSampler(__func__, _PU_FILE, std::to_string(__LINE__), t, true);
 //@}
 
 #endif
@@ -80,6 +80,8 @@
 #define pu_gpu_mem_request(ngpus) std::string(" --query-gpu=memory.used ")
 #define pu_gpu_memusage_request(ngpus) std::string(" --query-gpu=utilization.memory ")
 #define pu_gpu_formating(ngpus) std::string(" --format=csv,noheader,nounits ")
+// streaming query of usage, power, memory used and memory usage, one line per gpu every loop_ms
+#define pu_gpu_stream_request(loop_ms) std::string(" --query-gpu=utilization.gpu,power.draw,memory.used,utilization.memory --format=csv,noheader,nounits --loop-ms=") + std::to_string(loop_ms)
 #endif
 
 #endif
@@ -128,6 +130,8 @@ kernelfunc<<<blksize,threadsperblk>>>(__VA_ARGS__)
 #define pu_gpu_mem_request(ngpus) std::string(" --query-gpu=memory.used ")
 #define pu_gpu_memusage_request(ngpus) std::string(" --query-gpu=utilization.memory ")
 #define pu_gpu_formating(ngpus) std::string(" --format=csv,noheader,nounits ")
+// streaming query of usage, power, memory used and memory usage, one line per gpu every loop_ms
+#define pu_gpu_stream_request(loop_ms) std::string(" --query-gpu=utilization.gpu,power.draw,memory.used,utilization.memory --format=csv,noheader,nounits --loop-ms=") + std::to_string(loop_ms)
 
 #endif
 
@@ -0,0 +1,63 @@
+/*! \file profile_util_heap.h
+ *  \brief this file contains the interface to the heap allocation tracker, a library of its own
+ *  that interposes malloc, free and operator new and delete when linked or preloaded
+ */
+
+
+#ifndef _PROFILE_UTIL_HEAP
+#define _PROFILE_UTIL_HEAP
+
+#include <cstddef>
+#include <cstdint>
+
+/// \defgroup heap tracker limits
+//@{
+/// number of bins of the allocation size histogram, bin i counting sizes in [2^(i-1), 2^i)
+#define PU_HEAP_NBINS 48
+/// number of regions allocations are attributed to, the last counting all regions beyond
+#define PU_HEAP_MAX_REGIONS 64
+/// number of allocation sites tracked per thread, a power of 2
+#define PU_HEAP_MAX_SITES 4096
+/// number of threads with counters of their own, the last counters shared by all threads beyond
+#define PU_HEAP_MAX_THREADS 256
+//@}
+
+// only the tracker defines the functions, they are null elsewhere unless the tracker is loaded
+#ifdef _PU_HEAP_TRACKER
+#define _PU_HEAP_WEAK
+#else
+#define _PU_HEAP_WEAK __attribute__((weak))
+#endif
+
+extern "C" {
+    /// allocation counters of a thread
+    struct pu_heap_counters {
+        /// number of allocations and frees, bytes requested and bytes allocated but not yet freed
+        /// (which can be negative for a thread freeing memory allocated by others)
+        uint64_t count;
+        uint64_t frees;
+        uint64_t bytes;
+        int64_t live_bytes;
+        uint64_t histogram[PU_HEAP_NBINS];
+        /// allocations and bytes of each region
+        uint64_t region_count[PU_HEAP_MAX_REGIONS];
+        uint64_t region_bytes[PU_HEAP_MAX_REGIONS];
+        /// return address of the allocation sites, zero if unused, with their allocations and bytes
+        uintptr_t site[PU_HEAP_MAX_SITES];
+        uint64_t site_count[PU_HEAP_MAX_SITES];
+        uint64_t site_bytes[PU_HEAP_MAX_SITES];
+    };
+
+    /// set the region to which the following allocations of the calling thread are attributed
+    _PU_HEAP_WEAK void pu_heap_set_region(int region);
+    /// get the region of the calling thread
+    _PU_HEAP_WEAK int pu_heap_get_region();
+    /// suspend (or resume) tracking the allocations of the calling thread
+    _PU_HEAP_WEAK void pu_heap_suspend(int suspend);
+    /// number of threads whose allocations have been tracked
+    _PU_HEAP_WEAK int pu_heap_num_threads();
+    /// copy the counters of a thread
+    _PU_HEAP_WEAK void pu_heap_read_thread(int thread, struct pu_heap_counters *counters);
+}
+
+#endif
@@ -7,7 +7,7 @@ import pybind11
 ext_modules = [
     Extension(
         'profile_util',  # Module name
-        ['src/profile_util_pyinterface.cpp', 'src/profile_util.cpp', 'src/mem_util.cpp', 'src/thread_affinity_util.cpp', 'src/time_util.cpp',  'src/pybind11_git_revision.cpp'],  # Source file(s)
+        ['src/profile_util_pyinterface.cpp', 'src/profile_util.cpp', 'src/mem_util.cpp', 'src/thread_affinity_util.cpp', 'src/time_util.cpp', 'src/process_util.cpp', 'src/metric_util.cpp', 'src/region_util.cpp',  'src/pybind11_git_revision.cpp'],  # Source file(s)
 
         include_dirs=[
             pybind11.get_include(),  # Include Pybind11 headers
@@ -0,0 +1,328 @@
+/*! \file heap_util.cpp
+ *  \brief Heap allocation tracker, interposing malloc, free and operator new and delete.
+ *  Built as a library of its own, which is either linked or preloaded with LD_PRELOAD,
+ *  and forwards to the glibc allocator.
+ */
+
+#define _PU_HEAP_TRACKER
+
+#include <malloc.h>
+#include <cerrno>
+#include <new>
+#include <atomic>
+
+#include "profile_util_heap.h"
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void *__libc_valloc(size_t size);
+    void *__libc_pvalloc(size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace {
+
+    // counters of a thread, only written by that thread except for the shared counters of the
+    // threads beyond PU_HEAP_MAX_THREADS. They are zero initialised before any allocation
+    struct thread_counters {
+        std::atomic<uint64_t> count, frees, bytes;
+        std::atomic<int64_t> live_bytes;
+        std::atomic<uint64_t> histogram[PU_HEAP_NBINS];
+        std::atomic<uint64_t> region_count[PU_HEAP_MAX_REGIONS], region_bytes[PU_HEAP_MAX_REGIONS];
+        std::atomic<uintptr_t> site[PU_HEAP_MAX_SITES];
+        std::atomic<uint64_t> site_count[PU_HEAP_MAX_SITES], site_bytes[PU_HEAP_MAX_SITES];
+    };
+    thread_counters counters[PU_HEAP_MAX_THREADS];
+    constexpr size_t site_probes = 32;
+    std::atomic<int> nthreads{0};
+
+    struct thread_state {
+        thread_counters *counters;
+        bool shared;
+        /// set while tracking, or when suspended, so allocations made meanwhile are not tracked
+        bool busy;
+        int region;
+    };
+    // initial exec so that accessing the state does not allocate
+    thread_local thread_state state __attribute__((tls_model("initial-exec"))) = {nullptr, false, false, 0};
+
+    template<typename T> inline void _add(std::atomic<T> &counter, T value)
+    {
+        // a single writer need not pay for an atomic read modify write
+        if (state.shared) counter.fetch_add(value, std::memory_order_relaxed);
+        else counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    inline thread_counters *_get_counters()
+    {
+        if (state.counters == nullptr)
+        {
+            int thread = nthreads.fetch_add(1, std::memory_order_relaxed);
+            if (thread >= PU_HEAP_MAX_THREADS - 1)
+            {
+                thread = PU_HEAP_MAX_THREADS - 1;
+                state.shared = true;
+            }
+            state.counters = &counters[thread];
+        }
+        return state.counters;
+    }
+
+    inline int _bin(size_t size)
+    {
+        int bin = (size == 0) ? 0 : 64 - __builtin_clzll(size);
+        return (bin < PU_HEAP_NBINS) ? bin : PU_HEAP_NBINS - 1;
+    }
+
+    void _track_alloc(void *ptr, size_t size, void *site)
+    {
+        if (ptr == nullptr || state.busy) return;
+        state.busy = true;
+        auto c = _get_counters();
+        _add<uint64_t>(c->count, 1);
+        _add<uint64_t>(c->bytes, size);
+        _add<int64_t>(c->live_bytes, malloc_usable_size(ptr));
+        _add<uint64_t>(c->histogram[_bin(size)], 1);
+        _add<uint64_t>(c->region_count[state.region], 1);
+        _add<uint64_t>(c->region_bytes[state.region], size);
+        // open addressing on the return address with a bounded probe, so a table filled by the
+        // sites of start up (MPI allocates from thousands) does not slow every allocation down.
+        // Allocations from sites that do not fit are counted but not attributed to a site
+        auto key = reinterpret_cast<uintptr_t>(site);
+        size_t h = ((key >> 2) * 0x9E3779B97F4A7C15ull) >> 32;
+        for (size_t i=0;i<site_probes;i++)
+        {
+            auto j = (h + i) & (PU_HEAP_MAX_SITES - 1);
+            auto entry = c->site[j].load(std::memory_order_relaxed);
+            if (entry == 0)
+            {
+                if (state.shared)
+                {
+                    if (!c->site[j].compare_exchange_strong(entry, key, std::memory_order_relaxed) && entry != key) continue;
+                }
+                else c->site[j].store(key, std::memory_order_relaxed);
+            }
+            else if (entry != key) continue;
+            _add<uint64_t>(c->site_count[j], 1);
+            _add<uint64_t>(c->site_bytes[j], size);
+            break;
+        }
+        state.busy = false;
+    }
+
+    inline void _track_free(void *ptr)
+    {
+        if (ptr == nullptr || state.busy) return;
+        auto c = _get_counters();
+        _add<uint64_t>(c->frees, 1);
+        _add<int64_t>(c->live_bytes, -static_cast<int64_t>(malloc_usable_size(ptr)));
+    }
+
+    inline void *_new(size_t size, void *site)
+    {
+        if (size == 0) size = 1;
+        void *ptr;
+        while ((ptr = __libc_malloc(size)) == nullptr)
+        {
+            auto handler = std::get_new_handler();
+            if (handler == nullptr) throw std::bad_alloc();
+            handler();
+        }
+        _track_alloc(ptr, size, site);
+        return ptr;
+    }
+
+    inline void *_new_aligned(size_t size, std::align_val_t alignment, void *site)
+    {
+        if (size == 0) size = 1;
+        void *ptr;
+        while ((ptr = __libc_memalign(static_cast<size_t>(alignment), size)) == nullptr)
+        {
+            auto handler = std::get_new_handler();
+            if (handler == nullptr) throw std::bad_alloc();
+            handler();
+        }
+        _track_alloc(ptr, size, site);
+        return ptr;
+    }
+
+    inline void _free(void *ptr)
+    {
+        _track_free(ptr);
+        __libc_free(ptr);
+    }
+}
+
+#define _PU_CALLER __builtin_return_address(0)
+
+extern "C" {
+
+    void *malloc(size_t size)
+    {
+        auto ptr = __libc_malloc(size);
+        _track_alloc(ptr, size, _PU_CALLER);
+        return ptr;
+    }
+
+    void *calloc(size_t n, size_t size)
+    {
+        auto ptr = __libc_calloc(n, size);
+        _track_alloc(ptr, n * size, _PU_CALLER);
+        return ptr;
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        // the old block is freed, unless reallocation fails
+        size_t old_size = (ptr != nullptr) ? malloc_usable_size(ptr) : 0;
+        auto new_ptr = __libc_realloc(ptr, size);
+        if (new_ptr == nullptr && size != 0) return new_ptr;
+        if (ptr != nullptr && !state.busy)
+        {
+            auto c = _get_counters();
+            _add<uint64_t>(c->frees, 1);
+            _add<int64_t>(c->live_bytes, -static_cast<int64_t>(old_size));
+        }
+        _track_alloc(new_ptr, size, _PU_CALLER);
+        return new_ptr;
+    }
+
+    void *reallocarray(void *ptr, size_t n, size_t size)
+    {
+        size_t total;
+        if (__builtin_mul_overflow(n, size, &total))
+        {
+            errno = ENOMEM;
+            return nullptr;
+        }
+        return realloc(ptr, total);
+    }
+
+    void free(void *ptr)
+    {
+        _free(ptr);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        auto ptr = __libc_memalign(alignment, size);
+        _track_alloc(ptr, size, _PU_CALLER);
+        return ptr;
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        auto ptr = __libc_memalign(alignment, size);
+        _track_alloc(ptr, size, _PU_CALLER);
+        return ptr;
+    }
+
+    int posix_memalign(void **memptr, size_t alignment, size_t size)
+    {
+        if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+        auto ptr = __libc_memalign(alignment, size);
+        if (ptr == nullptr) return ENOMEM;
+        _track_alloc(ptr, size, _PU_CALLER);
+        *memptr = ptr;
+        return 0;
+    }
+
+    void *valloc(size_t size)
+    {
+        auto ptr = __libc_valloc(size);
+        _track_alloc(ptr, size, _PU_CALLER);
+        return ptr;
+    }
+
+    void *pvalloc(size_t size)
+    {
+        auto ptr = __libc_pvalloc(size);
+        _track_alloc(ptr, size, _PU_CALLER);
+        return ptr;
+    }
+
+    void pu_heap_set_region(int region)
+    {
+        if (region < 0 || region >= PU_HEAP_MAX_REGIONS) region = PU_HEAP_MAX_REGIONS - 1;
+        state.region = region;
+    }
+
+    int pu_heap_get_region()
+    {
+        return state.region;
+    }
+
+    void pu_heap_suspend(int suspend)
+    {
+        state.busy = (suspend != 0);
+    }
+
+    int pu_heap_num_threads()
+    {
+        int n = nthreads.load(std::memory_order_relaxed);
+        return (n < PU_HEAP_MAX_THREADS) ? n : PU_HEAP_MAX_THREADS;
+    }
+
+    void pu_heap_read_thread(int thread, struct pu_heap_counters *out)
+    {
+        auto &c = counters[thread];
+        auto load = [](auto &counter) {return counter.load(std::memory_order_relaxed);};
+        out->count = load(c.count);
+        out->frees = load(c.frees);
+        out->bytes = load(c.bytes);
+        out->live_bytes = load(c.live_bytes);
+        for (int i=0;i<PU_HEAP_NBINS;i++) out->histogram[i] = load(c.histogram[i]);
+        for (int i=0;i<PU_HEAP_MAX_REGIONS;i++)
+        {
+            out->region_count[i] = load(c.region_count[i]);
+            out->region_bytes[i] = load(c.region_bytes[i]);
+        }
+        for (int i=0;i<PU_HEAP_MAX_SITES;i++)
+        {
+            out->site[i] = load(c.site[i]);
+            out->site_count[i] = load(c.site_count[i]);
+            out->site_bytes[i] = load(c.site_bytes[i]);
+        }
+    }
+}
+
+void *operator new(size_t size) {return _new(size, _PU_CALLER);}
+void *operator new[](size_t size) {return _new(size, _PU_CALLER);}
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    try {return _new(size, _PU_CALLER);}
+    catch (...) {return nullptr;}
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    try {return _new(size, _PU_CALLER);}
+    catch (...) {return nullptr;}
+}
+void *operator new(size_t size, std::align_val_t alignment) {return _new_aligned(size, alignment, _PU_CALLER);}
+void *operator new[](size_t size, std::align_val_t alignment) {return _new_aligned(size, alignment, _PU_CALLER);}
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    try {return _new_aligned(size, alignment, _PU_CALLER);}
+    catch (...) {return nullptr;}
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    try {return _new_aligned(size, alignment, _PU_CALLER);}
+    catch (...) {return nullptr;}
+}
+
+void operator delete(void *ptr) noexcept {_free(ptr);}
+void operator delete[](void *ptr) noexcept {_free(ptr);}
+void operator delete(void *ptr, size_t) noexcept {_free(ptr);}
+void operator delete[](void *ptr, size_t) noexcept {_free(ptr);}
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {_free(ptr);}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {_free(ptr);}
+void operator delete(void *ptr, std::align_val_t) noexcept {_free(ptr);}
+void operator delete[](void *ptr, std::align_val_t) noexcept {_free(ptr);}
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {_free(ptr);}
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {_free(ptr);}
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {_free(ptr);}
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {_free(ptr);}
@@ -2,101 +2,248 @@
  *  \brief Get memory 
  */
 
-#include <unordered_set>
 #include <map>
+#include <charconv>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <malloc.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <sys/sysinfo.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
 
 #include "profile_util.h"
 
 /// get the memory use looking as the /proc/self/status file 
 namespace profiling_util {
 
-    // return the memory usage;
-    memory_usage get_memory_usage() {
+    // parse the "Name:   value kB" lines of /proc files without allocating, 
+    // returning the number of fields found
+    template<std::size_t N> 
+    static int _parse_proc_fields(const char *text, const char *end, std::pair<std::string_view, std::size_t *> (&fields)[N])
+    {
+        int nfound = 0;
+        while (text < end)
+        {
+            auto newline = static_cast<const char *>(std::memchr(text, '\n', end - text));
+            if (newline == nullptr) newline = end;
+            auto colon = static_cast<const char *>(std::memchr(text, ':', newline - text));
+            if (colon != nullptr)
+            {
+                std::string_view name(text, colon - text);
+                for (auto &[field, value] : fields)
+                {
+                    if (name != field) continue;
+                    auto p = colon + 1;
+                    while (p < newline && (*p == ' ' || *p == '\t')) p++;
+                    std::size_t amount = 0;
+                    auto [q, ec] = std::from_chars(p, newline, amount);
+                    if (ec != std::errc()) break;
+                    // counts have no unit, everything else is in kB
+                    if (q + 3 <= newline && std::memcmp(q, " kB", 3) == 0) amount *= 1024;
+                    *value = amount;
+                    nfound++;
+                    break;
+                }
+            }
+            text = newline + 1;
+        }
+        return nfound;
+    }
+
+    // descriptor of a /proc/self file kept open between reads. A forked child would
+    // otherwise read its parent's file, so it is reopened if the process changes. 
+    // Samplers and application threads read it concurrently, so it is opened under a lock
+    // and the pid is published only once the descriptor is set
+    struct _proc_self_file 
+    {
+        const char *path;
+        std::atomic<int> fd{-1};
+        std::atomic<pid_t> pid{-1};
+        std::mutex mtx;
+        _proc_self_file(const char *_path) : path(_path) {}
+        int get() 
+        {
+            auto current = getpid();
+            if (pid.load(std::memory_order_acquire) == current) return fd.load(std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(mtx);
+            if (pid.load(std::memory_order_relaxed) != current) 
+            {
+                auto prior = fd.load(std::memory_order_relaxed);
+                if (prior >= 0) close(prior);
+                fd.store(open(path, O_RDONLY | O_CLOEXEC), std::memory_order_relaxed);
+                pid.store(current, std::memory_order_release);
+            }
+            return fd.load(std::memory_order_relaxed);
+        }
+    };
+
+    // peak RSS of the process before VmHWM was last reset by a MemoryScope, so that the 
+    // lifetime peak is still reported
+    static std::atomic<std::size_t> _rss_peak_before_reset{0};
+
+    // the memory usage as given in /proc/self/status
+    static memory_usage _read_status()
+    {
         memory_usage usage;
+        static _proc_self_file status{"/proc/self/status"};
+        char text[8192];
+        auto nread = pread(status.get(), text, sizeof(text), 0);
+        if (nread <= 0) {
+            std::cerr << "Couldn't read " << status.path << " for memory usage reading" <<std::endl;
+            return usage;
+        }
+        std::pair<std::string_view, std::size_t *> fields[] = {
+            {"VmSize", &usage.vm.current}, {"VmPeak", &usage.vm.peak}, 
+            {"VmRSS", &usage.rss.current}, {"VmHWM", &usage.rss.peak},
+            {"RssAnon", &usage.rss_anon}, {"RssFile", &usage.rss_file}, {"RssShmem", &usage.rss_shmem},
+        };
+        _parse_proc_fields(text, text + nread, fields);
+        return usage;
+    }
 
-        const char *stat_file = "/proc/self/status";
-        std::ifstream f(stat_file);
-        if (!f.is_open()) {
-            std::cerr << "Couldn't open " << stat_file << " for memory usage reading" <<std::endl;
+    // return the memory usage;
+    memory_usage get_memory_usage(bool full_status, bool proportional) {
+        memory_usage usage;
+        if (proportional) 
+        {
+            usage = get_memory_usage(full_status, false);
+            static _proc_self_file rollup{"/proc/self/smaps_rollup"};
+            char text[4096];
+            auto nread = pread(rollup.get(), text, sizeof(text), 0);
+            if (nread <= 0) return usage;
+            std::pair<std::string_view, std::size_t *> fields[] = {
+                {"Pss", &usage.pss}, {"Pss_Anon", &usage.pss_anon}, {"Pss_Shmem", &usage.pss_shmem},
+                {"AnonHugePages", &usage.anon_hugepages}, {"Swap", &usage.swap},
+            };
+            _parse_proc_fields(text, text + nread, fields);
+            return usage;
         }
-        for (std::string line; std::getline(f, line); ) {
-            auto start = line.find("VmSize:");
-            if (start != std::string::npos) {
-                std::istringstream is(line.substr(start + 7));
-                is >> usage.vm.current;
-                continue;
-            }
-            start = line.find("VmPeak:");
-            if (start != std::string::npos) {
-                std::istringstream is(line.substr(start + 7));
-                is >> usage.vm.peak;
-                continue;
-            }
-            start = line.find("VmRSS:");
-            if (start != std::string::npos) {
-                std::istringstream is(line.substr(start + 6));
-                is >> usage.rss.current;
-                continue;
+        if (!full_status) 
+        {
+            // size and resident set in pages, all that is needed for the current usage
+            static _proc_self_file statm{"/proc/self/statm"};
+            static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+            char text[256];
+            auto nread = pread(statm.get(), text, sizeof(text), 0);
+            if (nread <= 0) return usage;
+            const char *end = text + nread;
+            auto [p, ec] = std::from_chars(text, end, usage.vm.current);
+            if (ec == std::errc() && p < end) std::from_chars(p + 1, end, usage.rss.current);
+            usage.vm.current *= page_size;
+            usage.rss.current *= page_size;
+            return usage;
+        }
+        usage = _read_status();
+        usage.rss.peak = std::max(usage.rss.peak, _rss_peak_before_reset.load());
+        return usage;
+    }
+
+    std::mutex MemoryScope::scopes_mtx;
+    std::vector<MemoryScope *> MemoryScope::scopes;
+
+    MemoryScope::MemoryScope(const std::string &f, const std::string &F, const std::string &l, float sample_time)
+    {
+        {
+            std::lock_guard<std::mutex> lock(scopes_mtx);
+            // writing 5 resets VmHWM to the current RSS, which needs Linux 4.0 or later 
+            auto before = _read_status();
+            int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+            if (fd >= 0) 
+            {
+                peak_reset = (write(fd, "5", 1) == 1);
+                close(fd);
             }
-            start = line.find("VmHWM:");
-            if (start != std::string::npos) {
-                std::istringstream is(line.substr(start + 6));
-                is >> usage.rss.peak;
-                continue;
+            if (peak_reset) 
+            {
+                // the peak is lost to the lifetime peak and to any enclosing scopes, so keep it
+                auto prior = _rss_peak_before_reset.load();
+                while (prior < before.rss.peak && !_rss_peak_before_reset.compare_exchange_weak(prior, before.rss.peak));
+                for (auto &scope : scopes) scope->folded_peak = std::max(scope->folded_peak, before.rss.peak);
             }
+            scopes.push_back(this);
         }
+        start = get_memory_usage();
+        if (peak_reset) return;
+        // otherwise sample the RSS to find the peak, which can miss short lived peaks
+        sampler = std::make_unique<GeneralSampler>(f, F, l, sample_time, false, false);
+        sampler->AddSource(std::make_shared<FunctionSource>("rss", "B", 
+            []() {return static_cast<double>(get_memory_usage(false).rss.current);}));
+    }
 
-        // all values above are in kB
-        usage.vm.current *= 1024;
-        usage.vm.peak *= 1024;
-        usage.rss.current *= 1024;
-        usage.rss.peak *= 1024;
-        return usage;
+    MemoryScope::~MemoryScope()
+    {
+        std::lock_guard<std::mutex> lock(scopes_mtx);
+        scopes.erase(std::remove(scopes.begin(), scopes.end(), this), scopes.end());
     }
 
-    // execute a command on the command line
-    std::string exec_sys_cmd(std::string cmd) 
+    memory_usage MemoryScope::GetUsage()
     {
-        std::string result;
-        if (cmd.size()==0) return result;
-        std::array<char, 128> buffer;
-        std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-        if (!pipe) {
-            throw std::runtime_error("popen() failed!");
+        auto usage = get_memory_usage();
+        std::size_t peak = std::max(start.rss.current, usage.rss.current);
+        if (peak_reset) 
+        {
+            std::lock_guard<std::mutex> lock(scopes_mtx);
+            peak = std::max({peak, _read_status().rss.peak, folded_peak});
         }
-        while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-            result += buffer.data();
+        else 
+        {
+            std::vector<double> times, values;
+            sampler->GetSamples("rss", times, values);
+            for (auto &v : values) peak = std::max(peak, static_cast<std::size_t>(v));
         }
-        return result;
+        usage.rss.peak = peak;
+        usage.vm.change = usage.vm.current - start.vm.current;
+        usage.rss.change = usage.rss.current - start.rss.current;
+        return usage;
+    }
+
+    // parse /proc/meminfo into the system memory stats
+    static bool _parse_meminfo(const char *text, const char *end, sys_memory_stats &sysmem)
+    {
+        std::size_t buffers = 0, cached = 0, reclaimable = 0, avail = 0;
+        std::pair<std::string_view, std::size_t *> fields[] = {
+            {"MemTotal", &sysmem.total}, {"MemFree", &sysmem.free}, {"MemAvailable", &avail},
+            {"Buffers", &buffers}, {"Cached", &cached}, {"SReclaimable", &reclaimable},
+            {"Shmem", &sysmem.shared}, {"SwapTotal", &sysmem.swap_total}, {"SwapFree", &sysmem.swap_free},
+            {"Dirty", &sysmem.dirty}, {"Writeback", &sysmem.writeback},
+            {"HugePages_Total", &sysmem.hugepages_total}, {"HugePages_Free", &sysmem.hugepages_free},
+            {"Hugepagesize", &sysmem.hugepage_size},
+        };
+        if (_parse_proc_fields(text, end, fields) == 0) return false;
+        // follow free, which counts reclaimable slab as cache
+        sysmem.cache = buffers + cached + reclaimable;
+        sysmem.avail = (avail > 0) ? avail : sysmem.free + sysmem.cache;
+        // as procps-ng 4 free does, memory that is not available is used
+        sysmem.used = (sysmem.total > sysmem.avail) ? sysmem.total - sysmem.avail : 0;
+        return true;
     }
 
     sys_memory_stats get_system_memory()
     {
-        auto text = exec_sys_cmd("free | head -n 2 | tail -n 1");
-        std::size_t doubleSpace = text.find("  ");
-        while (doubleSpace != std::string::npos)
+        sys_memory_stats sysmem;
+        // keep the file open, it is regenerated when read from the start
+        static int fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
         {
-            text.erase(doubleSpace, 1);
-            doubleSpace = text.find("  ");
+            char text[8192];
+            auto nread = pread(fd, text, sizeof(text), 0);
+            if (nread > 0 && _parse_meminfo(text, text + nread, sysmem)) return sysmem;
         }
-        std::vector<std::string> words{};
-        size_t pos = 0;
-        std::string space_delimiter = " ";
-        sys_memory_stats sysmem;
-        // order of data should follow the following headers
-        // std::vector<std::string> headers = {"total", "used", "free", "shared", "buff/cache", "available"};
-        while ((pos = text.find(space_delimiter)) != std::string::npos) {
-            if (text.substr(0, pos) != space_delimiter) words.push_back(text.substr(0, pos));
-            text.erase(0, pos + space_delimiter.length());
-        }
-        words.push_back(text.substr(0,text.size()-1));
-        // all memory reported back in kilobytes
-        sysmem.total = std::stoul(words[1])*1024;
-        sysmem.used = std::stoul(words[2])*1024;
-        sysmem.free = std::stoul(words[3])*1024;
-        sysmem.shared = std::stoul(words[4])*1024;
-        sysmem.cache = std::stoul(words[5])*1024;
-        sysmem.avail = std::stoul(words[6])*1024;
+        // without /proc, use what the kernel reports through sysinfo
+        struct sysinfo info;
+        if (sysinfo(&info) != 0) return sysmem;
+        std::size_t unit = info.mem_unit;
+        sysmem.total = info.totalram * unit;
+        sysmem.free = info.freeram * unit;
+        sysmem.shared = info.sharedram * unit;
+        sysmem.cache = info.bufferram * unit;
+        sysmem.avail = sysmem.free + sysmem.cache;
+        sysmem.used = (sysmem.total > sysmem.avail) ? sysmem.total - sysmem.avail : 0;
+        sysmem.swap_total = info.totalswap * unit;
+        sysmem.swap_free = info.freeswap * unit;
         return sysmem;
     }
 
@@ -145,17 +292,14 @@ namespace profiling_util {
         return std::make_tuple(memory_report.str(), memory_usage);
     }
 
-    //report usage along with change relative to another sampling of memory
-    std::tuple<std::string, memory_usage> GetMemUsage(
-        const memory_usage &prior_mem_usage,
+    // report usage whose change has been set
+    static std::tuple<std::string, memory_usage> _get_mem_usage_change_report(
+        const memory_usage &memory_usage,
         const std::string &function, 
         const std::string &file,
         const std::string &line_num
         )
     {
-        auto memory_usage = get_memory_usage();
-        memory_usage.vm.change = memory_usage.vm.current - prior_mem_usage.vm.current;
-        memory_usage.rss.change = memory_usage.rss.current - prior_mem_usage.rss.current;
         std::ostringstream memory_report;
         auto append_memory_stats = [&memory_report](const char *name, const memory_stats &stats) {
             memory_report << name << " current/peak/change : " << memory_amount(stats.current) << " / " << memory_amount(stats.peak)<< " / "<< memory_amount(stats.change);
@@ -167,13 +311,254 @@ namespace profiling_util {
         return std::make_tuple(memory_report.str(), memory_usage);
     }
 
+    //report usage along with change relative to another sampling of memory
+    std::tuple<std::string, memory_usage> GetMemUsage(
+        const memory_usage &prior_mem_usage,
+        const std::string &function, 
+        const std::string &file,
+        const std::string &line_num
+        )
+    {
+        auto memory_usage = get_memory_usage();
+        memory_usage.vm.change = memory_usage.vm.current - prior_mem_usage.vm.current;
+        memory_usage.rss.change = memory_usage.rss.current - prior_mem_usage.rss.current;
+        return _get_mem_usage_change_report(memory_usage, function, file, line_num);
+    }
+
+    //report usage along with the change and the peak RSS since the start of a scope
+    std::tuple<std::string, memory_usage> GetMemUsage(
+        MemoryScope &scope,
+        const std::string &function, 
+        const std::string &file,
+        const std::string &line_num
+        )
+    {
+        return _get_mem_usage_change_report(scope.GetUsage(), function, file, line_num);
+    }
+
+    std::string ReportMemUsage(
+        MemoryScope &scope,
+        const std::string &function, 
+        const std::string &file,
+        const std::string &line_num
+        )
+    {
+        std::string report;
+        memory_usage mem;
+        std::tie(report, mem) = GetMemUsage(scope, function, file, line_num);
+        return report;
+    }
+
     #ifdef _MPI 
-    inline std::string _gethostname(){
-        char hnbuf[64];
-        memset(hnbuf, 0, sizeof(hnbuf));
-        (void)gethostname(hnbuf, sizeof(hnbuf));
-        return std::string(hnbuf);
+    // free the node communicators cached on a communicator, when it is freed
+    static int _free_node_comms(MPI_Comm, int, void *attribute, void *)
+    {
+        auto comms = static_cast<mpi_node_comms *>(attribute);
+        if (comms->leaders != MPI_COMM_NULL) MPI_Comm_free(&comms->leaders);
+        MPI_Comm_free(&comms->node);
+        delete comms;
+        return MPI_SUCCESS;
+    }
+
+    const mpi_node_comms &MPIGetNodeComms(MPI_Comm comm)
+    {
+        static int keyval = []() {
+            int k;
+            MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, _free_node_comms, &k, nullptr);
+            return k;
+        }();
+        void *attribute;
+        int found;
+        MPI_Comm_get_attr(comm, keyval, &attribute, &found);
+        if (found) return *static_cast<mpi_node_comms *>(attribute);
+        // ordered by rank, so the root of comm leads its node and is the first leader
+        auto comms = new mpi_node_comms;
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &comms->node);
+        MPI_Comm_rank(comms->node, &comms->node_rank);
+        MPI_Comm_size(comms->node, &comms->node_size);
+        MPI_Comm_split(comm, (comms->node_rank == 0) ? 0 : MPI_UNDEFINED, rank, &comms->leaders);
+        int index[2] = {0, 1};
+        if (comms->leaders != MPI_COMM_NULL)
+        {
+            MPI_Comm_rank(comms->leaders, &index[0]);
+            MPI_Comm_size(comms->leaders, &index[1]);
+        }
+        MPI_Bcast(index, 2, MPI_INT, 0, comms->node);
+        comms->node_index = index[0];
+        comms->nnodes = index[1];
+        MPI_Comm_set_attr(comm, keyval, comms);
+        return *comms;
+    }
+
+    // a value of a node with the hostname of its leader
+    template<typename T> struct _node_record {
+        char host[64];
+        T value;
+    };
+
+    // gather the values of the nodes from their leaders to the root of comm, the only rank
+    // getting them, so the root receives a record per node rather than per rank
+    template<typename T> 
+    static void _gather_node_values(const mpi_node_comms &comms, const T &value, std::vector<std::string> &names, std::vector<T> &values)
+    {
+        if (comms.leaders == MPI_COMM_NULL) return;
+        _node_record<T> record{};
+        (void)gethostname(record.host, sizeof(record.host) - 1);
+        record.value = value;
+        std::vector<_node_record<T>> records((comms.node_index == 0) ? comms.nnodes : 0);
+        MPI_Gather(&record, sizeof(record), MPI_BYTE, records.data(), sizeof(record), MPI_BYTE, 0, comms.leaders);
+        for (auto &r : records) 
+        {
+            names.emplace_back(r.host);
+            values.push_back(r.value);
+        }
+    }
+
+    // nodes are listed in reports when there are at most this many, otherwise summarised
+    static constexpr int _max_nodes_listed = 16;
+    // number of bins of the histograms the percentiles of distributions are interpolated in
+    static constexpr int _distribution_nbins = 1000;
+
+    // a candidate outlier, the outliers of ranks reduced by keeping the largest deviations
+    struct _outlier_record {
+        double deviation;
+        double value;
+        int rank;
+        char host[52];
+    };
+
+    // merge two lists of outliers in decreasing deviation into the second
+    static void _merge_outliers(void *in, void *inout, int *len, MPI_Datatype *type)
+    {
+        int size;
+        MPI_Type_size(*type, &size);
+        std::size_t ntop = size / sizeof(_outlier_record);
+        std::vector<_outlier_record> merged(2 * ntop);
+        for (int i=0;i<*len;i++) 
+        {
+            auto a = static_cast<_outlier_record *>(in) + i * ntop, b = static_cast<_outlier_record *>(inout) + i * ntop;
+            std::merge(a, a + ntop, b, b + ntop, merged.begin(), 
+                [](const _outlier_record &x, const _outlier_record &y) {return x.deviation > y.deviation;});
+            std::copy(merged.begin(), merged.begin() + ntop, b);
+        }
+    }
+
+    // distribution of a value over the ranks of comm, only complete on its root. The cost on the 
+    // root depends on the number of bins and outliers, not the number of ranks
+    static mpi_distribution _mpi_distribution(MPI_Comm comm, double value, int ntop)
+    {
+        mpi_distribution dist;
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &dist.count);
+        double sum = value, extremes[2] = {-value, value};
+        MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+        MPI_Allreduce(MPI_IN_PLACE, extremes, 2, MPI_DOUBLE, MPI_MAX, comm);
+        dist.mean = sum / dist.count;
+        dist.min = -extremes[0];
+        dist.max = extremes[1];
+
+        // the histogram with the sum of the squared deviations in its last element
+        std::vector<double> histogram(_distribution_nbins + 1, 0.0), total(_distribution_nbins + 1, 0.0);
+        double width = (dist.max - dist.min) / _distribution_nbins;
+        int bin = (width > 0) ? std::min(static_cast<int>((value - dist.min) / width), _distribution_nbins - 1) : 0;
+        histogram[bin] = 1;
+        histogram[_distribution_nbins] = (value - dist.mean) * (value - dist.mean);
+        MPI_Reduce(histogram.data(), total.data(), histogram.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+        if (rank == 0) 
+        {
+            dist.std = sqrt(total[_distribution_nbins] / dist.count);
+            double *percentiles[] = {&dist.p50, &dist.p90, &dist.p99};
+            double quantiles[] = {0.5, 0.9, 0.99};
+            for (int q=0;q<3;q++) 
+            {
+                double target = quantiles[q] * dist.count, cumulative = 0;
+                int b = 0;
+                while (b < _distribution_nbins - 1 && cumulative + total[b] < target) cumulative += total[b++];
+                double fraction = (total[b] > 0) ? (target - cumulative) / total[b] : 0;
+                *percentiles[q] = std::clamp(dist.min + (b + fraction) * width, dist.min, dist.max);
+            }
+        }
+
+        // the ntop ranks deviating most from the mean, the others padded with negative deviations.
+        // Ranks at the mean are not outliers
+        ntop = std::max(1, std::min(ntop, dist.count));
+        std::vector<_outlier_record> outliers(ntop), top(ntop);
+        for (auto &o : outliers) o.deviation = -1;
+        outliers[0].deviation = std::abs(value - dist.mean);
+        outliers[0].value = value;
+        outliers[0].rank = rank;
+        (void)gethostname(outliers[0].host, sizeof(outliers[0].host) - 1);
+        MPI_Datatype type;
+        MPI_Type_contiguous(ntop * sizeof(_outlier_record), MPI_BYTE, &type);
+        MPI_Type_commit(&type);
+        MPI_Op op;
+        MPI_Op_create(_merge_outliers, 1, &op);
+        MPI_Reduce(outliers.data(), top.data(), 1, type, op, 0, comm);
+        MPI_Op_free(&op);
+        MPI_Type_free(&type);
+        if (rank == 0) 
+        {
+            for (auto &o : top) if (o.deviation > 0) dist.outliers.push_back({o.rank, o.host, o.value});
+        }
+        return dist;
+    }
+
+    static void _report_distribution(std::ostringstream &report, const char *name, const char *kind, const mpi_distribution &dist)
+    {
+        auto amount = [](double value) {return memory_amount(static_cast<std::size_t>(std::max(value, 0.0)));};
+        report << "\t" << name << " mean/std/min/max : " << amount(dist.mean) << " / " << amount(dist.std) 
+            << " / " << amount(dist.min) << " / " << amount(dist.max) 
+            << "; p50/p90/p99 : " << amount(dist.p50) << " / " << amount(dist.p90) << " / " << amount(dist.p99)
+            << "; outliers :";
+        for (auto &o : dist.outliers) report << " " << kind << " " << o.rank << " (" << o.host << ") : " << amount(o.value) << ";";
+        report << " \n";
+    }
+
+    // sum the memory usage of the ranks on each node on its leader, the sum of the PSS counting 
+    // pages shared by the ranks, such as shared memory windows, once, and take the largest peaks
+    static memory_usage _get_node_mem_usage(const mpi_node_comms &comms, memory_usage mem)
+    {
+        auto summed = [](memory_usage &m) {
+            return std::array<std::size_t *, 12>{&m.vm.current, &m.vm.change, &m.rss.current, &m.rss.change,
+                &m.rss_anon, &m.rss_file, &m.rss_shmem, &m.pss, &m.pss_anon, &m.pss_shmem, &m.anon_hugepages, &m.swap};
+        };
+        std::array<uint64_t, 12> sums, node_sums;
+        std::array<uint64_t, 2> peaks = {mem.vm.peak, mem.rss.peak}, node_peaks;
+        auto fields = summed(mem);
+        for (std::size_t i=0;i<fields.size();i++) sums[i] = *fields[i];
+        MPI_Reduce(sums.data(), node_sums.data(), sums.size(), MPI_UINT64_T, MPI_SUM, 0, comms.node);
+        MPI_Reduce(peaks.data(), node_peaks.data(), peaks.size(), MPI_UINT64_T, MPI_MAX, 0, comms.node);
+        memory_usage node_mem;
+        fields = summed(node_mem);
+        for (std::size_t i=0;i<fields.size();i++) *fields[i] = node_sums[i];
+        node_mem.vm.peak = node_peaks[0];
+        node_mem.rss.peak = node_peaks[1];
+        return node_mem;
+    }
+
+    static mpi_memory_summary _get_mem_usage_summary(MPI_Comm comm, const mpi_node_comms &comms, const memory_usage &mem, const memory_usage &node_mem, int ntop)
+    {
+        mpi_memory_summary summary;
+        summary.rank_rss = _mpi_distribution(comm, mem.rss.current, ntop);
+        if (comms.leaders != MPI_COMM_NULL) 
+        {
+            summary.node_rss = _mpi_distribution(comms.leaders, node_mem.rss.current, ntop);
+            summary.node_pss = _mpi_distribution(comms.leaders, node_mem.pss, ntop);
+        }
+        return summary;
+    }
+
+    static void _report_mem_usage_summary(std::ostringstream &report, const mpi_memory_summary &summary)
+    {
+        report << "\tRanks : " << summary.rank_rss.count << ", Nodes : " << summary.node_rss.count << " \n";
+        _report_distribution(report, "Rank RSS", "rank", summary.rank_rss);
+        _report_distribution(report, "Node RSS", "node", summary.node_rss);
+        _report_distribution(report, "Node PSS", "node", summary.node_pss);
     }
+
     std::string MPIReportNodeMemUsage(
         MPI_Comm &comm, 
         const std::string &function, 
@@ -181,6 +566,8 @@ namespace profiling_util {
         const std::string &line_num
     )
     {
+        // the nodes are not gathered when they are too many to be listed
+        if (MPIGetNodeComms(comm).nnodes > _max_nodes_listed) return MPIReportNodeMemUsageSummary(comm, function, file, line_num);
         auto [report, nodes, mem] = MPIGetNodeMemUsage(comm, function, file, line_num);
         return report;
     }
@@ -192,62 +579,95 @@ namespace profiling_util {
         const std::string &line_num
     )
     {
-        // parse comm to find unique hosts
-        int commsize, rank;
-        MPI_Comm_size(comm, &commsize);
-        MPI_Comm_rank(comm, &rank);
-        auto hostname = _gethostname();
-        int size = hostname.size()+1, maxsize = 0;
-        MPI_Allreduce(&size, &maxsize, 1, MPI_INTEGER, MPI_MAX, comm);
-        std::vector<char> allhostnames(maxsize*commsize);
-        for (auto i=size;i<maxsize;i++) hostname+=" ";
-        MPI_Gather(hostname.c_str(), maxsize, MPI_CHAR, allhostnames.data(), maxsize, MPI_CHAR, 0, comm);
-        std::unordered_set<std::string> hostnames;
-        for (auto i=0;i<commsize;i++) 
-        {
-            std::string s;
-            for (auto j=0;j<maxsize;j++) s += allhostnames[i*maxsize+j];
-            hostnames.insert(s);
-        }
-        // get gather memory usage for all mpi ranks and sum them
-        auto mem = get_memory_usage();
-        std::vector<memory_usage> allmems(commsize);
-        MPI_Gather(&mem, sizeof(memory_usage), MPI_BYTE, allmems.data(), sizeof(memory_usage), MPI_BYTE, 0, comm);
-        std::map<std::string, memory_usage> memonhost;
-        memory_usage nomem;
-        for (auto &s:hostnames) memonhost.insert(std::pair<std::string,memory_usage>(s,nomem));
-        for (auto i=0;i<commsize;i++) 
-        {
-            std::string s;
-            for (auto j=0;j<maxsize;j++) s += allhostnames[i*maxsize+j];
-            memonhost[s] += allmems[i];
-        }
-        // now construct memory report
-        std::ostringstream memory_report;
+        auto &comms = MPIGetNodeComms(comm);
+        auto mem = get_memory_usage(true, true);
+        auto node_mem = _get_node_mem_usage(comms, mem);
         std::vector<std::string> namehosts;
         std::vector<memory_usage> memhosts;
+        _gather_node_values(comms, node_mem, namehosts, memhosts);
+
+        // now construct memory report
+        std::ostringstream memory_report;
         auto append_memory_stats = [&memory_report](const char *name, const memory_stats &stats) {
             memory_report << name << " current/peak/change : " << memory_amount(stats.current) << " / " << memory_amount(stats.peak)<< " / "<< memory_amount(stats.change);
         };
         memory_report << "Node memory report @ " << function << " "<<file<<":L"<<line_num <<" :\n";
-        for (auto &m:memonhost) {
-            memory_report << "\tNode : " << m.first<<" : ";
-            append_memory_stats("VM", m.second.vm);
+        if (comms.nnodes > _max_nodes_listed) 
+        {
+            _report_mem_usage_summary(memory_report, _get_mem_usage_summary(comm, comms, mem, node_mem, 5));
+            return std::make_tuple(memory_report.str(), namehosts, memhosts);
+        }
+        for (std::size_t i=0;i<namehosts.size();i++) {
+            auto &m = memhosts[i];
+            memory_report << "\tNode : " << namehosts[i] <<" : ";
+            append_memory_stats("VM", m.vm);
             memory_report << "; ";
-            append_memory_stats("RSS", m.second.rss);
+            append_memory_stats("RSS", m.rss);
+            memory_report << "; PSS : " << memory_amount(m.pss);
+            memory_report << " (Anon : " << memory_amount(m.pss_anon) << ", Shmem : " << memory_amount(m.pss_shmem) << ")";
+            memory_report << "; THP : " << memory_amount(m.anon_hugepages);
+            if (m.rss_anon > 0) memory_report << " (" << 100.0 * m.anon_hugepages / m.rss_anon << "% of Anon)";
+            memory_report << "; Swap : " << memory_amount(m.swap);
             memory_report <<" \n";
-            namehosts.push_back(m.first);
-            memhosts.push_back(m.second);
         }
         return std::make_tuple(memory_report.str(), namehosts, memhosts);
     }
 
+    std::string MPIReportNodeMemUsageSummary(
+        MPI_Comm &comm, 
+        const std::string &function, 
+        const std::string &file,
+        const std::string &line_num,
+        int ntop
+    )
+    {
+        auto [report, summary] = MPIGetNodeMemUsageSummary(comm, function, file, line_num, ntop);
+        return report;
+    }
+
+    std::tuple<std::string, mpi_memory_summary> MPIGetNodeMemUsageSummary(
+        MPI_Comm &comm, 
+        const std::string &function, 
+        const std::string &file,
+        const std::string &line_num,
+        int ntop
+    )
+    {
+        auto &comms = MPIGetNodeComms(comm);
+        auto mem = get_memory_usage(true, true);
+        auto node_mem = _get_node_mem_usage(comms, mem);
+        auto summary = _get_mem_usage_summary(comm, comms, mem, node_mem, ntop);
+        std::ostringstream memory_report;
+        memory_report << "Node memory summary @ " << function << " "<<file<<":L"<<line_num <<" :\n";
+        _report_mem_usage_summary(memory_report, summary);
+        return std::make_tuple(memory_report.str(), summary);
+    }
+
+    // the distributions of the used and available memory of the nodes, over their leaders
+    static void _report_node_system_mem_summary(std::ostringstream &report, const mpi_node_comms &comms, const sys_memory_stats &mem)
+    {
+        if (comms.leaders == MPI_COMM_NULL) return;
+        auto used = _mpi_distribution(comms.leaders, mem.used, 5);
+        auto avail = _mpi_distribution(comms.leaders, mem.avail, 5);
+        report << "\tNodes : " << used.count << " \n";
+        _report_distribution(report, "Used ", "node", used);
+        _report_distribution(report, "Avail", "node", avail);
+    }
+
     std::string MPIReportNodeSystemMem(MPI_Comm &comm,
         const std::string &function, 
         const std::string &file, 
         const std::string &line_num
         )
     {
+        auto &comms = MPIGetNodeComms(comm);
+        if (comms.nnodes > _max_nodes_listed) 
+        {
+            std::ostringstream memory_report;
+            memory_report << "Node system memory report @ " << function << " "<<file<<":L"<<line_num <<" :\n";
+            if (comms.node_rank == 0) _report_node_system_mem_summary(memory_report, comms, get_system_memory());
+            return memory_report.str();
+        }
         auto [report, nodes, mem] = MPIGetNodeSystemMem(comm, function, file, line_num);
         return report;
     }
@@ -259,62 +679,44 @@ namespace profiling_util {
         const std::string &line_num
     )
     {
-        // parse comm to find unique hosts
-        int commsize, rank;
-        MPI_Comm_size(comm, &commsize);
-        MPI_Comm_rank(comm, &rank);
-        
-        auto hostname = _gethostname();
-        int size = hostname.size()+1, maxsize = 0;
-        MPI_Allreduce(&size, &maxsize, 1, MPI_INTEGER, MPI_MAX, comm);
-        std::vector<char> allhostnames(maxsize*commsize);
-        for (auto i=size;i<maxsize;i++) hostname+=" ";
-        MPI_Gather(hostname.c_str(), maxsize, MPI_CHAR, allhostnames.data(), maxsize, MPI_CHAR, 0, comm);
-        std::unordered_set<std::string> hostnames;
-        for (auto i=0;i<commsize;i++) 
-        {
-            std::string s;
-            for (auto j=0;j<maxsize;j++) s += allhostnames[i*maxsize+j];
-            hostnames.insert(s);
-        }
-        // get gather memory usage for all mpi ranks and sum them
-        auto mem = get_system_memory();
-        std::vector<sys_memory_stats> allmems(commsize);
-        MPI_Gather(&mem, sizeof(sys_memory_stats), MPI_BYTE, allmems.data(), sizeof(sys_memory_stats), MPI_BYTE, 0, comm);
-        std::map<std::string, sys_memory_stats> memonhost;
-        for (auto i=0;i<commsize;i++) 
-        {
-            std::string s;
-            for (auto j=0;j<maxsize;j++) s += allhostnames[i*maxsize+j];
-            memonhost.insert_or_assign(s,allmems[i]);
-        }
-        // now construct memory report
-        std::ostringstream memory_report;
+        // the memory of the system is the same for all ranks on a node, only the leaders read it
+        auto &comms = MPIGetNodeComms(comm);
         std::vector<std::string> namehosts;
         std::vector<sys_memory_stats> memhosts;
+        sys_memory_stats mem;
+        if (comms.node_rank == 0) mem = get_system_memory();
+        _gather_node_values(comms, mem, namehosts, memhosts);
+
+        // now construct memory report
+        std::ostringstream memory_report;
         auto append_memory_stats = [&memory_report](const char *name, const size_t &stat) {
             memory_report << name << ": " << memory_amount(stat);
         };
         memory_report << "Node system memory report @ " << function << " "<<file<<":L"<<line_num <<" :\n";
-        for (auto &m:memonhost) 
-        {
-            memory_report << "\tNode : " << m.first<<" : ";
-            append_memory_stats("Total ", m.second.total);memory_report << "; ";
-            append_memory_stats("Used  ", m.second.used);memory_report << "; ";
-            append_memory_stats("Free  ", m.second.free);memory_report << "; ";
-            append_memory_stats("Shared", m.second.shared);memory_report << "; ";
-            append_memory_stats("Cache ", m.second.cache);memory_report << "; ";
-            append_memory_stats("Avail ", m.second.avail);memory_report << "; ";
+        if (comms.nnodes > _max_nodes_listed) 
+        {
+            _report_node_system_mem_summary(memory_report, comms, mem);
+            return std::make_tuple(memory_report.str(), namehosts, memhosts);
+        }
+        for (std::size_t i=0;i<namehosts.size();i++) 
+        {
+            auto &m = memhosts[i];
+            memory_report << "\tNode : " << namehosts[i] <<" : ";
+            append_memory_stats("Total ", m.total);memory_report << "; ";
+            append_memory_stats("Used  ", m.used);memory_report << "; ";
+            append_memory_stats("Free  ", m.free);memory_report << "; ";
+            append_memory_stats("Shared", m.shared);memory_report << "; ";
+            append_memory_stats("Cache ", m.cache);memory_report << "; ";
+            append_memory_stats("Avail ", m.avail);memory_report << "; ";
+            append_memory_stats("Swap  ", m.swap_total-m.swap_free);memory_report << "; ";
+            append_memory_stats("Dirty ", m.dirty);memory_report << "; ";
+            append_memory_stats("Writeback", m.writeback);memory_report << "; ";
+            if (m.hugepages_total > 0) {
+                append_memory_stats("HugePages", (m.hugepages_total-m.hugepages_free)*m.hugepage_size);memory_report << "; ";
+            }
             memory_report <<" \n";
-            namehosts.push_back(m.first);
-            memhosts.push_back(m.second);
         }
-        auto new_report = memory_report.str();
-        auto removeNulls = [&new_report]() {
-            new_report.erase(std::remove(new_report.begin(), new_report.end(), '\0'), new_report.end());
-        };
-        removeNulls();
-        return std::make_tuple(new_report, namehosts, memhosts);
+        return std::make_tuple(memory_report.str(), namehosts, memhosts);
     }
     #endif
 
@@ -362,6 +764,12 @@ namespace profiling_util {
         append_memory_stats("Shared", sys_mem.shared);memory_report << "; ";
         append_memory_stats("Cache ", sys_mem.cache);memory_report << "; ";
         append_memory_stats("Avail ", sys_mem.avail);memory_report << "; ";
+        append_memory_stats("Swap  ", sys_mem.swap_total-sys_mem.swap_free);memory_report << "; ";
+        append_memory_stats("Dirty ", sys_mem.dirty);memory_report << "; ";
+        append_memory_stats("Writeback", sys_mem.writeback);memory_report << "; ";
+        if (sys_mem.hugepages_total > 0) {
+            append_memory_stats("HugePages", (sys_mem.hugepages_total-sys_mem.hugepages_free)*sys_mem.hugepage_size);memory_report << "; ";
+        }
         return std::make_tuple(memory_report.str(), sys_mem);
     }
 
@@ -385,7 +793,558 @@ namespace profiling_util {
         append_memory_stats("Shared", sys_mem.shared, sys_mem.shared-prior_mem_usage.shared);memory_report << "; ";
         append_memory_stats("Cache ", sys_mem.cache, sys_mem.cache-prior_mem_usage.cache);memory_report << "; ";
         append_memory_stats("Avail ", sys_mem.avail, sys_mem.avail-prior_mem_usage.avail);memory_report << "; ";
+        auto swap = sys_mem.swap_total-sys_mem.swap_free, prior_swap = prior_mem_usage.swap_total-prior_mem_usage.swap_free;
+        append_memory_stats("Swap  ", swap, swap-prior_swap);memory_report << "; ";
+        append_memory_stats("Dirty ", sys_mem.dirty, sys_mem.dirty-prior_mem_usage.dirty);memory_report << "; ";
+        append_memory_stats("Writeback", sys_mem.writeback, sys_mem.writeback-prior_mem_usage.writeback);memory_report << "; ";
         return std::make_tuple(memory_report.str(), sys_mem);
     }
-} 
 
+    // regions of the heap tracker, the first being untagged and the last all regions beyond the limit
+    static std::mutex _heap_regions_mtx;
+    static std::vector<std::string> _heap_regions = {"untagged"};
+
+    // do not track the allocations of the calling thread while in scope
+    struct _heap_suspend {
+        _heap_suspend() {if (heap_tracker_loaded()) pu_heap_suspend(1);}
+        ~_heap_suspend() {if (heap_tracker_loaded()) pu_heap_suspend(0);}
+    };
+
+    bool heap_tracker_loaded()
+    {
+        return pu_heap_read_thread != nullptr;
+    }
+
+    void SetHeapRegion(const Timer &t)
+    {
+        if (!heap_tracker_loaded()) return;
+        _heap_suspend suspend;
+        auto ref = t.get_ref();
+        std::lock_guard<std::mutex> lock(_heap_regions_mtx);
+        auto it = std::find(_heap_regions.begin(), _heap_regions.end(), ref);
+        int region = it - _heap_regions.begin();
+        if (it == _heap_regions.end()) 
+        {
+            if (region < PU_HEAP_MAX_REGIONS - 1) _heap_regions.push_back(ref);
+            else region = PU_HEAP_MAX_REGIONS - 1;
+        }
+        pu_heap_set_region(region);
+    }
+
+    void ClearHeapRegion()
+    {
+        if (heap_tracker_loaded()) pu_heap_set_region(0);
+    }
+
+    heap_stats get_heap_stats()
+    {
+        heap_stats stats;
+        if (!heap_tracker_loaded()) return stats;
+        _heap_suspend suspend;
+        stats.active = true;
+        auto counters = std::make_unique<pu_heap_counters>();
+        std::vector<heap_alloc_stats> regions(PU_HEAP_MAX_REGIONS);
+        std::unordered_map<uintptr_t, heap_alloc_stats> sites;
+        for (int t=0;t<pu_heap_num_threads();t++) 
+        {
+            pu_heap_read_thread(t, counters.get());
+            stats.count += counters->count;
+            stats.frees += counters->frees;
+            stats.bytes += counters->bytes;
+            stats.live_bytes += counters->live_bytes;
+            for (int i=0;i<PU_HEAP_NBINS;i++) stats.histogram[i] += counters->histogram[i];
+            for (int i=0;i<PU_HEAP_MAX_REGIONS;i++) 
+            {
+                regions[i].count += counters->region_count[i];
+                regions[i].bytes += counters->region_bytes[i];
+            }
+            for (int i=0;i<PU_HEAP_MAX_SITES;i++) 
+            {
+                if (counters->site[i] == 0) continue;
+                auto &site = sites[counters->site[i]];
+                site.site = counters->site[i];
+                site.count += counters->site_count[i];
+                site.bytes += counters->site_bytes[i];
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(_heap_regions_mtx);
+            for (size_t i=0;i<regions.size();i++) 
+            {
+                if (regions[i].count == 0) continue;
+                regions[i].name = (i < _heap_regions.size()) ? _heap_regions[i] : "other regions";
+                stats.regions.push_back(regions[i]);
+            }
+        }
+        for (auto &[address, site] : sites) stats.sites.push_back(site);
+        std::sort(stats.sites.begin(), stats.sites.end(), [](const heap_alloc_stats &a, const heap_alloc_stats &b) {return a.count > b.count;});
+        return stats;
+    }
+
+    // name of the function at an allocation site and its offset, otherwise the offset in the 
+    // object, which addr2line can resolve
+    static std::string _heap_site_name(uintptr_t site)
+    {
+        Dl_info info;
+        std::ostringstream name;
+        if (dladdr(reinterpret_cast<void *>(site), &info) == 0 || info.dli_fname == nullptr) 
+        {
+            name << "0x" << std::hex << site;
+            return name.str();
+        }
+        if (info.dli_sname != nullptr) 
+        {
+            int status;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            name << ((status == 0) ? demangled : info.dli_sname);
+            std::free(demangled);
+            name << "+0x" << std::hex << site - reinterpret_cast<uintptr_t>(info.dli_saddr);
+        }
+        else name << __extract_filename(info.dli_fname) << "+0x" << std::hex << site - reinterpret_cast<uintptr_t>(info.dli_fbase);
+        return name.str();
+    }
+
+    static std::string _report_heap_stats(const heap_stats &stats, std::size_t niterations,
+        const std::string &function, const std::string &file, const std::string &line_num, int nsites)
+    {
+        std::ostringstream report;
+        report << "Heap report @ " << function << " " << file << ":L" << line_num << " : ";
+        if (!stats.active) 
+        {
+            report << "heap tracker not loaded, link or preload libprofile_util_heap";
+            return report.str();
+        }
+        if (niterations > 0) 
+        {
+            report << "per iteration over " << niterations << " iterations : allocations = " << static_cast<double>(stats.count) / niterations
+                << ", requested = " << memory_amount(stats.bytes / niterations)
+                << ", frees = " << static_cast<double>(stats.frees) / niterations << " | ";
+        }
+        report << "Allocations = " << stats.count << ", requested = " << memory_amount(stats.bytes) 
+            << ", frees = " << stats.frees << ", live = ";
+        if (stats.live_bytes < 0) report << "-" << memory_amount(-stats.live_bytes);
+        else report << memory_amount(stats.live_bytes);
+        report << " | Sizes :";
+        for (int i=0;i<PU_HEAP_NBINS;i++) 
+        {
+            if (stats.histogram[i] == 0) continue;
+            if (i == 0) report << " 0 B : ";
+            else report << " [" << memory_amount(std::size_t(1) << (i-1)) << ", " << memory_amount(std::size_t(1) << i) << ") : ";
+            report << stats.histogram[i] << ";";
+        }
+        report << " | Regions :";
+        for (auto &r : stats.regions) report << " " << r.name << " : " << r.count << " (" << memory_amount(r.bytes) << ");";
+        report << " | Top sites :";
+        for (int i=0;i<nsites && i<static_cast<int>(stats.sites.size());i++) 
+        {
+            auto &s = stats.sites[i];
+            report << " " << _heap_site_name(s.site) << " : " << s.count << " (" << memory_amount(s.bytes) << ");";
+        }
+        return report.str();
+    }
+
+    std::string ReportHeapStats(
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num, 
+        int nsites
+        )
+    {
+        auto stats = get_heap_stats();
+        _heap_suspend suspend;
+        return _report_heap_stats(stats, 0, function, file, line_num, nsites);
+    }
+
+    std::string ReportHeapStats(
+        const heap_stats &prior, 
+        std::size_t niterations,
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num, 
+        int nsites
+        )
+    {
+        auto stats = get_heap_stats();
+        _heap_suspend suspend;
+        // the change since the prior state, regions and sites matched by name and address
+        stats.count -= prior.count;
+        stats.frees -= prior.frees;
+        stats.bytes -= prior.bytes;
+        stats.live_bytes -= prior.live_bytes;
+        for (int i=0;i<PU_HEAP_NBINS;i++) stats.histogram[i] -= prior.histogram[i];
+        auto subtract = [](std::vector<heap_alloc_stats> &current, const std::vector<heap_alloc_stats> &before, auto key) {
+            std::unordered_map<decltype(key(before[0])), const heap_alloc_stats *> index;
+            for (auto &b : before) index[key(b)] = &b;
+            for (auto &c : current) 
+            {
+                auto it = index.find(key(c));
+                if (it == index.end()) continue;
+                c.count -= it->second->count;
+                c.bytes -= it->second->bytes;
+            }
+            current.erase(std::remove_if(current.begin(), current.end(), [](const heap_alloc_stats &c) {return c.count == 0;}), current.end());
+        };
+        subtract(stats.regions, prior.regions, [](const heap_alloc_stats &s) {return s.name;});
+        subtract(stats.sites, prior.sites, [](const heap_alloc_stats &s) {return s.site;});
+        std::sort(stats.sites.begin(), stats.sites.end(), [](const heap_alloc_stats &a, const heap_alloc_stats &b) {return a.count > b.count;});
+        return _report_heap_stats(stats, std::max<std::size_t>(niterations, 1), function, file, line_num, nsites);
+    }
+
+    // value of an attribute of an element of the malloc_info XML, zero if missing
+    static std::size_t _xml_attribute(std::string_view line, std::string_view name)
+    {
+        auto p = line.find(name);
+        while (p != std::string_view::npos && line.substr(p + name.size(), 2) != "=\"") p = line.find(name, p + 1);
+        if (p == std::string_view::npos) return 0;
+        auto begin = line.data() + p + name.size() + 2;
+        std::size_t value = 0;
+        std::from_chars(begin, line.data() + line.size(), value);
+        return value;
+    }
+
+    // parse the arenas (heaps) of the malloc_info XML. The totals follow the heaps, 
+    // only that of mmapped chunks is not already given by mallinfo
+    static void _parse_malloc_info(std::string_view xml, heap_state &state)
+    {
+        malloc_arena_state *arena = nullptr;
+        auto is = [](std::string_view line, std::string_view element) {return line.find(element) != std::string_view::npos;};
+        while (!xml.empty())
+        {
+            auto newline = xml.find('\n');
+            auto line = xml.substr(0, newline);
+            xml.remove_prefix(newline == std::string_view::npos ? xml.size() : newline + 1);
+            if (is(line, "<heap ")) 
+            {
+                state.arenas.emplace_back();
+                arena = &state.arenas.back();
+                arena->nr = _xml_attribute(line, "nr");
+            }
+            else if (is(line, "</heap>")) arena = nullptr;
+            else if (arena != nullptr) 
+            {
+                if (is(line, "<total type=\"fast\"")) {
+                    arena->fast_count = _xml_attribute(line, "count");
+                    arena->fast_bytes = _xml_attribute(line, "size");
+                }
+                else if (is(line, "<total type=\"rest\"")) {
+                    arena->free_count = _xml_attribute(line, "count");
+                    arena->free_bytes = _xml_attribute(line, "size");
+                }
+                else if (is(line, "<system type=\"current\"")) arena->system_bytes = _xml_attribute(line, "size");
+                else if (is(line, "<system type=\"max\"")) arena->max_system_bytes = _xml_attribute(line, "size");
+            }
+            else if (is(line, "<total type=\"mmap\"")) 
+            {
+                state.mmap_count = _xml_attribute(line, "count");
+                state.mmap_bytes = _xml_attribute(line, "size");
+            }
+        }
+    }
+
+    heap_state get_heap_state()
+    {
+        heap_state state;
+#ifdef __GLIBC__
+        // the state is read while the heap tracker is suspended, so that reading it is not counted
+        _heap_suspend suspend;
+        state.valid = true;
+#if __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33
+        auto info = mallinfo2();
+#else 
+        // the fields of mallinfo are int and wrap beyond 2 GiB 
+        auto info = mallinfo();
+#endif
+        state.arena_bytes = info.arena;
+        state.in_use_bytes = info.uordblks;
+        state.free_bytes = info.fordblks;
+        state.fastbin_bytes = info.fsmblks;
+        state.free_chunks = info.ordblks;
+        state.top_bytes = info.keepcost;
+        state.mmap_count = info.hblks;
+        state.mmap_bytes = info.hblkhd;
+        char *xml = nullptr;
+        std::size_t size = 0;
+        auto stream = open_memstream(&xml, &size);
+        if (stream != nullptr) 
+        {
+            if (malloc_info(0, stream) == 0) 
+            {
+                fflush(stream);
+                _parse_malloc_info(std::string_view(xml, size), state);
+            }
+            fclose(stream);
+            free(xml);
+        }
+#endif
+        return state;
+    }
+
+    static void _report_heap_state(std::ostringstream &report, const heap_state &state)
+    {
+        report << "Arenas : " << state.arenas.size() << " holding " << memory_amount(state.arena_bytes)
+            << ", in use = " << memory_amount(state.in_use_bytes) 
+            << ", free = " << memory_amount(state.free_bytes) << " (" << state.free_fraction() * 100.0 << "%)"
+            << " in " << state.free_chunks << " chunks, fast bins = " << memory_amount(state.fastbin_bytes)
+            << ", releasable top = " << memory_amount(state.top_bytes)
+            << ", fragmentation = " << state.fragmentation() * 100.0 << "%"
+            << "; mmapped = " << memory_amount(state.mmap_bytes) << " in " << state.mmap_count << " chunks";
+        for (auto &a : state.arenas)
+        {
+            auto free_bytes = a.fast_bytes + a.free_bytes;
+            report << " | Arena " << a.nr << " : system current/max " << memory_amount(a.system_bytes) 
+                << " / " << memory_amount(a.max_system_bytes) << ", free = " << memory_amount(free_bytes)
+                << " (" << (a.system_bytes > 0 ? static_cast<double>(free_bytes) / a.system_bytes * 100.0 : 0.0) << "%)"
+                << " in " << a.fast_count + a.free_count << " chunks";
+        }
+    }
+
+    std::tuple<std::string, heap_state> GetHeapState(
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num, 
+        bool trim
+        )
+    {
+        std::ostringstream report;
+        report << "Heap state @ " << function << " " << file << ":L" << line_num << " : ";
+        auto state = get_heap_state();
+        if (!state.valid) 
+        {
+            report << "only available with glibc";
+            return std::make_tuple(report.str(), state);
+        }
+        if (!trim) 
+        {
+            _report_heap_state(report, state);
+            return std::make_tuple(report.str(), state);
+        }
+        // free memory in holes is released with madvise, which lowers the RSS but not the memory
+        // held by the arenas, whereas the top of the arenas is returned to the system 
+        auto before = get_memory_usage(false);
+        auto t0 = std::chrono::steady_clock::now();
+        bool released = false;
+#ifdef __GLIBC__
+        released = malloc_trim(0) != 0;
+#endif
+        auto time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        auto after = get_memory_usage(false);
+        auto trimmed = get_heap_state();
+        auto change = [](std::size_t now, std::size_t prior) {
+            std::ostringstream amount;
+            if (now < prior) amount << "-" << memory_amount(prior - now);
+            else amount << memory_amount(now - prior);
+            return amount.str();
+        };
+        report << "malloc_trim " << (released ? "released memory" : "released nothing") << " in " << time << " [us]"
+            << " : RSS before/after/change " << memory_amount(before.rss.current) << " / " << memory_amount(after.rss.current) 
+            << " / " << change(after.rss.current, before.rss.current)
+            << "; arenas holding before/after/change " << memory_amount(state.arena_bytes) << " / " << memory_amount(trimmed.arena_bytes)
+            << " / " << change(trimmed.arena_bytes, state.arena_bytes)
+            << " | Before : ";
+        _report_heap_state(report, state);
+        report << " | After : ";
+        _report_heap_state(report, trimmed);
+        return std::make_tuple(report.str(), trimmed);
+    }
+
+    std::string ReportHeapState(
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num, 
+        bool trim
+        )
+    {
+        std::string report;
+        heap_state state;
+        std::tie(report, state) = GetHeapState(function, file, line_num, trim);
+        return report;
+    }
+
+    // parse a list of cpus such as 0-3,8,10-11 
+    static std::vector<int> _parse_cpu_list(const std::string &list)
+    {
+        std::vector<int> cpus;
+        std::istringstream ranges(list);
+        for (std::string range; std::getline(ranges, range, ',');) 
+        {
+            int first, last;
+            auto n = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+            if (n < 1) continue;
+            if (n == 1) last = first;
+            for (int cpu=first;cpu<=last;cpu++) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    const std::vector<int> &get_cpu_numa_nodes()
+    {
+        static const std::vector<int> nodes = []() {
+            std::vector<int> nodes(CPU_SETSIZE, 0);
+            std::error_code err;
+            for (auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", err)) 
+            {
+                auto name = entry.path().filename().string();
+                if (name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(name[4])) continue;
+                int node = std::stoi(name.substr(4));
+                std::ifstream cpulist(entry.path() / "cpulist");
+                std::string list;
+                std::getline(cpulist, list);
+                for (auto cpu : _parse_cpu_list(list)) if (cpu < CPU_SETSIZE) nodes[cpu] = node;
+            }
+            return nodes;
+        }();
+        return nodes;
+    }
+
+    std::vector<bool> get_numa_nodes(const cpu_set_t &mask)
+    {
+        auto &cpu_nodes = get_cpu_numa_nodes();
+        std::vector<bool> nodes;
+        for (int cpu=0;cpu<CPU_SETSIZE;cpu++) 
+        {
+            if (!CPU_ISSET(cpu, &mask)) continue;
+            auto node = cpu_nodes[cpu];
+            if (node >= static_cast<int>(nodes.size())) nodes.resize(node + 1, false);
+            nodes[node] = true;
+        }
+        return nodes;
+    }
+
+    numa_placement get_numa_placement(const void *ptr, std::size_t bytes, std::size_t nsamples)
+    {
+        numa_placement placement;
+        if (ptr == nullptr || bytes == 0 || nsamples == 0) return placement;
+        const std::size_t page_size = sysconf(_SC_PAGESIZE);
+        auto first = reinterpret_cast<uintptr_t>(ptr) / page_size;
+        auto last = (reinterpret_cast<uintptr_t>(ptr) + bytes - 1) / page_size;
+        placement.npages = last - first + 1;
+        placement.nsampled = std::min(nsamples, placement.npages);
+        std::vector<void *> pages(placement.nsampled);
+        std::vector<int> status(placement.nsampled, -ENOENT);
+        for (std::size_t i=0;i<pages.size();i++) 
+        {
+            auto page = first + (placement.nsampled > 1 ? i * (placement.npages - 1) / (placement.nsampled - 1) : 0);
+            pages[i] = reinterpret_cast<void *>(page * page_size);
+        }
+        // without nodes, move_pages only queries the node of each page
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0) 
+        {
+            if (errno != ENOSYS) return placement;
+            // a kernel without NUMA, with pages on the one node if present
+            for (std::size_t i=0;i<pages.size();i++) 
+            {
+                unsigned char present = 0;
+                status[i] = (mincore(pages[i], page_size, &present) == 0 && (present & 1)) ? 0 : -ENOENT;
+            }
+        }
+        placement.valid = true;
+        for (auto &s : status) 
+        {
+            if (s < 0) 
+            {
+                placement.not_present++;
+                continue;
+            }
+            if (s >= static_cast<int>(placement.node_pages.size())) placement.node_pages.resize(s + 1, 0);
+            placement.node_pages[s]++;
+        }
+        return placement;
+    }
+
+    static void _report_numa_placement(std::ostringstream &report, const numa_placement &placement)
+    {
+        auto present = placement.nsampled - placement.not_present;
+        report << placement.nsampled << " of " << placement.npages << " pages sampled, not present : " 
+            << (placement.nsampled > 0 ? 100.0 * placement.not_present / placement.nsampled : 0.0) << "%";
+        for (std::size_t n=0;n<placement.node_pages.size();n++) 
+        {
+            if (placement.node_pages[n] == 0) continue;
+            report << "; node " << n << " : " << 100.0 * placement.node_pages[n] / present << "%";
+        }
+    }
+
+    std::string ReportNUMAPlacement(
+        const void *ptr, 
+        std::size_t bytes, 
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num, 
+        std::size_t nsamples
+        )
+    {
+        std::ostringstream report;
+        report << "NUMA placement report @ " << function << " " << file << ":L" << line_num << " : " 
+            << memory_amount(bytes) << " at " << ptr << " : ";
+        auto placement = get_numa_placement(ptr, bytes, nsamples);
+        if (!placement.valid) 
+        {
+            report << "placement could not be queried";
+            return report.str();
+        }
+        _report_numa_placement(report, placement);
+        report << "\n";
+
+        // the affinity of the threads that would touch the range, the OpenMP team unless 
+        // already in a parallel region
+        struct thread_affinity {
+            std::string cpus;
+            int placement = -1;
+            std::vector<bool> nodes;
+        };
+        std::vector<thread_affinity> threads(1);
+        bool team = true;
+        int caller = 0;
+        auto get_affinity = [](thread_affinity &t) {
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            (void)sched_getaffinity(0, sizeof(mask), &mask);
+            char buffer[7 * CPU_SETSIZE];
+            memset(buffer, 0, sizeof(buffer));
+            cpuset_to_cstr(&mask, buffer);
+            t.cpus = buffer;
+            t.placement = sched_getcpu();
+            t.nodes = get_numa_nodes(mask);
+        };
+#ifdef _OPENMP
+        team = !omp_in_parallel();
+        if (team) 
+        {
+            threads.resize(omp_get_max_threads());
+            #pragma omp parallel
+            {
+                #pragma omp single
+                threads.resize(omp_get_num_threads());
+                get_affinity(threads[omp_get_thread_num()]);
+            }
+        }
+        else 
+        {
+            caller = omp_get_thread_num();
+            get_affinity(threads[0]);
+        }
+#else
+        get_affinity(threads[0]);
+#endif
+        int nremote = 0;
+        for (std::size_t t=0;t<threads.size();t++) 
+        {
+            auto &thread = threads[t];
+            // the part of the range touched by the thread with a static schedule
+            auto begin = bytes * t / threads.size(), end = bytes * (t + 1) / threads.size();
+            auto part = get_numa_placement(static_cast<const char *>(ptr) + begin, end - begin, std::max<std::size_t>(nsamples / threads.size(), 1));
+            auto present = part.nsampled - part.not_present;
+            auto local = part.pages_on(thread.nodes);
+            bool remote = present > 0 && 2 * local < present;
+            nremote += remote;
+            report << "\tThread " << (team ? static_cast<int>(t) : caller) << " : Core affinity = " << thread.cpus << " Core placement = " << thread.placement << " NUMA nodes =";
+            for (std::size_t n=0;n<thread.nodes.size();n++) if (thread.nodes[n]) report << " " << n;
+            report << " : bytes [" << begin << ", " << end << ") : ";
+            _report_numa_placement(report, part);
+            report << "; local : " << (present > 0 ? 100.0 * local / present : 0.0) << "%";
+            if (remote) report << " REMOTE";
+            report << "\n";
+        }
+        if (nremote > 0) report << "\tWARNING : " << nremote << " of " << threads.size() << " threads touch memory mostly on remote NUMA nodes\n";
+        return report.str();
+    }
+}
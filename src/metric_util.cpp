@@ -0,0 +1,307 @@
+/*! \file metric_util.cpp
+ *  \brief Sources of the metrics sampled by samplers
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+
+#include "profile_util.h"
+
+namespace profiling_util {
+
+    FunctionSource::FunctionSource(const std::string &name, const std::string &unit, std::function<double()> _func)
+    : MetricSource({{name, unit, 1}}), func(std::move(_func)) {}
+
+    void FunctionSource::Sample(double time, const store_func &store)
+    {
+        double value = func();
+        store(0, time, &value);
+    }
+
+    CPUUsageSource::CPUUsageSource(const std::string &name) : MetricSource({{name, "%", 1}}) {}
+
+    bool CPUUsageSource::Open()
+    {
+        prior_when = std::chrono::steady_clock::now();
+        prior_cputime = _get_process_cpu_time();
+        return true;
+    }
+
+    double CPUUsageSource::_get_process_cpu_time()
+    {
+        // finer than the clock ticks of /proc/self/stat, which are too coarse for short sample periods
+        timespec ts;
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) return 0;
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    void CPUUsageSource::Sample(double time, const store_func &store)
+    {
+        auto when = std::chrono::steady_clock::now();
+        auto cputime = _get_process_cpu_time();
+        double walltime = std::chrono::duration<double>(when - prior_when).count();
+        double usage = (walltime > 0) ? (cputime - prior_cputime) / walltime * 100.0 : 0.0;
+        prior_when = when;
+        prior_cputime = cputime;
+        store(0, time, &usage);
+    }
+
+    CommandSource::CommandSource(const std::string &name, const std::string &unit, const std::string &_cmd, int width)
+    : MetricSource({{name, unit, width}}), cmd(_cmd) {}
+
+    bool CommandSource::_poll()
+    {
+        std::array<char, 4096> text;
+        ssize_t nread;
+        while ((nread = read(fd, text.data(), text.size())) > 0) output.append(text.data(), nread);
+        if (nread < 0 && (errno == EAGAIN || errno == EINTR)) return false;
+        // the output is closed, the command has exited or is about to
+        close(fd);
+        wait_cmd(pid);
+        pid = fd = -1;
+        return true;
+    }
+
+    void CommandSource::_store_output(const store_func &store)
+    {
+        std::vector<double> vals(metrics[0].width, 0.0);
+        std::istringstream text(output);
+        std::string line;
+        for (auto &v : vals)
+        {
+            if (!std::getline(text, line)) break;
+            try {
+                v = std::stod(line);
+            }
+            // on two gcd cards, one will return N/A for power so catch it
+            // set val to zero
+            catch (const std::logic_error& ia) {
+                v = 0;
+            }
+        }
+        store(0, run_time, vals.data());
+    }
+
+    void CommandSource::Sample(double time, const store_func &store)
+    {
+        if (pid >= 0) 
+        {
+            if (!_poll()) 
+            {
+                if (noverruns++ == 0) 
+                {
+                    std::cerr << "Command " << cmd << " of metric " << metrics[0].name 
+                        << " takes longer than the sample period, skipping samples" << std::endl;
+                }
+                return;
+            }
+            _store_output(store);
+        }
+        output.clear();
+        run_time = time;
+        pid = spawn_cmd_with_pipe(cmd, fd, true);
+    }
+
+    void CommandSource::Close()
+    {
+        if (pid < 0) return;
+        // the output of an unfinished run is dropped
+        kill(pid, SIGTERM);
+        close(fd);
+        wait_cmd(pid);
+        pid = fd = -1;
+    }
+
+    FileSource::FileSource(const std::string &name, const std::string &unit, const std::string &_path)
+    : MetricSource({{name, unit, 1}}), path(_path) {}
+
+    bool FileSource::Open()
+    {
+        if (fd < 0) fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return fd >= 0;
+    }
+
+    void FileSource::Sample(double time, const store_func &store)
+    {
+        if (fd < 0) return;
+        char text[256];
+        // files in /sys are regenerated when read from the start
+        auto nread = pread(fd, text, sizeof(text) - 1, 0);
+        if (nread <= 0) return;
+        text[nread] = '\0';
+        double value = std::strtod(text, nullptr);
+        store(0, time, &value);
+    }
+
+    void FileSource::Close()
+    {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    MonitorStreamSource::MonitorStreamSource(const std::string &_cmd, std::vector<metric_info> _metrics, double _period)
+    : MetricSource(std::move(_metrics)), cmd(_cmd), period(_period)
+    {
+        parser = CSVStreamParser(metrics.size() > 0 ? metrics[0].width : 1, metrics.size());
+    }
+
+    bool MonitorStreamSource::Open()
+    {
+        if (pid >= 0) return true;
+        // records partially read before a restart are dropped
+        parser = CSVStreamParser(parser.GetNumRows(), parser.GetNumCols());
+        streamed = false;
+        pid = spawn_cmd_with_pipe(cmd, fd, true);
+        return pid >= 0;
+    }
+
+    void MonitorStreamSource::Sample(double time, const store_func &store)
+    {
+        if (fd < 0) return;
+        std::array<char, 4096> text;
+        ssize_t nread;
+        while ((nread = read(fd, text.data(), text.size())) > 0) parser.Append(text.data(), nread);
+        auto nrecords = parser.GetNumRecords();
+        auto nrows = parser.GetNumRows(), ncols = parser.GetNumCols();
+        std::vector<double> record, vals(nrows);
+        for (size_t k=0;k<nrecords;k++)
+        {
+            parser.Pop(record);
+            // the latest record is taken to be current, earlier ones a period apart
+            double record_time = std::max(time - (nrecords - 1 - k) * period, last_time);
+            last_time = record_time;
+            for (int c=0;c<ncols;c++)
+            {
+                for (int r=0;r<nrows;r++) vals[r] = record[r*ncols + c];
+                store(c, record_time, vals.data());
+            }
+        }
+        if (nrecords > 0) streamed = true;
+        if (nread != 0) return;
+        // the output is closed, the command has exited or crashed
+        close(fd);
+        wait_cmd(pid);
+        pid = fd = -1;
+        // a command failing without streaming is not launched every sample
+        if (nexits++ == 0) 
+        {
+            std::cerr << "Monitor " << cmd << " exited" << (streamed ? ", launching it again" : " without streaming records") << std::endl;
+        }
+        if (streamed) Open();
+    }
+
+    void MonitorStreamSource::Close()
+    {
+        if (pid < 0) return;
+        kill(pid, SIGTERM);
+        close(fd);
+        wait_cmd(pid);
+        pid = fd = -1;
+    }
+
+    // parse the "name: value" lines of /proc/self/io
+    static io_counters _parse_io_counters(char *text)
+    {
+        io_counters counters;
+        std::pair<const char *, uint64_t *> fields[] = {
+            {"rchar:", &counters.rchar}, {"wchar:", &counters.wchar},
+            {"syscr:", &counters.syscr}, {"syscw:", &counters.syscw},
+            {"read_bytes:", &counters.read_bytes}, {"write_bytes:", &counters.write_bytes},
+            {"cancelled_write_bytes:", &counters.cancelled_write_bytes},
+        };
+        for (auto &[name, value] : fields)
+        {
+            auto p = std::strstr(text, name);
+            if (p == nullptr) continue;
+            *value = std::strtoull(p + std::strlen(name), nullptr, 10);
+            counters.valid = true;
+        }
+        return counters;
+    }
+
+    static io_counters _read_io_counters(int fd)
+    {
+        char text[512];
+        auto nread = pread(fd, text, sizeof(text) - 1, 0);
+        if (nread <= 0) return io_counters();
+        text[nread] = '\0';
+        return _parse_io_counters(text);
+    }
+
+    io_counters get_io_counters()
+    {
+        int fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return io_counters();
+        auto counters = _read_io_counters(fd);
+        close(fd);
+        return counters;
+    }
+
+    ProcIOSource::ProcIOSource(const std::string &ops_name, const std::string &read_name, const std::string &write_name)
+    : MetricSource({{ops_name, "1/s", 2}, {read_name, "MiB/s", 2}, {write_name, "MiB/s", 2}}) {}
+
+    bool ProcIOSource::Open()
+    {
+        if (fd < 0) fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        prior_when = std::chrono::steady_clock::now();
+        prior = _read_io_counters(fd);
+        return prior.valid;
+    }
+
+    void ProcIOSource::Sample(double time, const store_func &store)
+    {
+        if (fd < 0) return;
+        auto when = std::chrono::steady_clock::now();
+        auto current = _read_io_counters(fd);
+        if (!current.valid) return;
+        double walltime = std::chrono::duration<double>(when - prior_when).count();
+        if (walltime <= 0) return;
+        auto rate = [walltime](uint64_t now, uint64_t before, double scale) {
+            return (now >= before) ? (now - before) / walltime * scale : 0.0;
+        };
+        const double mib = 1.0 / (1024.0 * 1024.0);
+        double ops[2] = {rate(current.syscr, prior.syscr, 1.0), rate(current.syscw, prior.syscw, 1.0)};
+        double reads[2] = {rate(current.rchar, prior.rchar, mib), rate(current.read_bytes, prior.read_bytes, mib)};
+        double writes[2] = {rate(current.wchar, prior.wchar, mib), rate(current.write_bytes, prior.write_bytes, mib)};
+        prior = current;
+        prior_when = when;
+        store(0, time, ops);
+        store(1, time, reads);
+        store(2, time, writes);
+    }
+
+    void ProcIOSource::Close()
+    {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    ProcMemorySource::ProcMemorySource(const std::string &mem_name, const std::string &region_name, std::shared_ptr<std::atomic<int>> _region)
+    : MetricSource({{mem_name, "MiB", 5}, {region_name, "", 1}}), region(std::move(_region)) {}
+
+    void ProcMemorySource::Sample(double time, const store_func &store)
+    {
+        // read the region first, so a sample is not attributed to a region entered while reading
+        double current_region = region->load();
+        auto usage = get_memory_usage();
+        const double mib = 1.0 / (1024.0 * 1024.0);
+        double values[5] = {usage.rss.current * mib, usage.vm.current * mib, 
+            usage.rss_anon * mib, usage.rss_file * mib, usage.rss_shmem * mib};
+        store(0, time, values);
+        store(1, time, &current_region);
+    }
+
+    SyntheticSource::SyntheticSource(const std::string &name, const std::string &unit, int width, std::function<void(double, double *)> _func)
+    : MetricSource({{name, unit, width}}), func(std::move(_func)) {}
+
+    SyntheticSource::SyntheticSource(const std::string &name, const std::string &unit, std::function<double(double)> _func)
+    : MetricSource({{name, unit, 1}}), func([f = std::move(_func)](double time, double *values){values[0] = f(time);}) {}
+
+    void SyntheticSource::Sample(double time, const store_func &store)
+    {
+        std::vector<double> vals(metrics[0].width, 0.0);
+        func(time, vals.data());
+        store(0, time, vals.data());
+    }
+}
@@ -0,0 +1,184 @@
+/*! \file process_util.cpp
+ *  \brief Launch commands with posix_spawn
+ */
+
+#include <spawn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <charconv>
+
+#include "profile_util.h"
+
+extern char **environ;
+
+namespace profiling_util {
+
+    bool split_plain_cmd(const std::string &cmd, std::vector<std::string> &args)
+    {
+        // any of these needs the shell to interpret the command
+        static const std::string shell_chars = "|&;<>()$`\\\"'*?[]#~{}!\n";
+        if (cmd.find_first_of(shell_chars) != std::string::npos) return false;
+        args.clear();
+        std::istringstream words(cmd);
+        for (std::string word; words >> word; ) args.push_back(word);
+        // a leading variable assignment also needs the shell
+        return args.size() > 0 && args[0].find('=') == std::string::npos;
+    }
+
+    pid_t spawn_cmd(const std::string &cmd, int out_fd, int err_fd)
+    {
+        std::vector<std::string> args;
+        bool plain = split_plain_cmd(cmd, args);
+        std::vector<char *> argv;
+        for (auto &a : args) argv.push_back(a.data());
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (out_fd >= 0) posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+        if (err_fd >= 0) posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+        // the sampling thread may have signals blocked, do not pass that on to the command
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t mask;
+        sigemptyset(&mask);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+        pid_t child;
+        int err = -1;
+        // plain commands are searched for in the PATH. If that fails, run the command through
+        // the shell, which reports the failure on standard error as it would for other commands
+        if (plain) err = posix_spawnp(&child, argv[0], &actions, &attr, argv.data(), environ);
+        if (err != 0) 
+        {
+            char shell[] = "/bin/sh", opt[] = "-c";
+            std::vector<char *> shell_argv = {shell, opt, const_cast<char *>(cmd.c_str()), nullptr};
+            err = posix_spawn(&child, shell, &actions, &attr, shell_argv.data(), environ);
+        }
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&actions);
+        if (err != 0) return -1;
+        return child;
+    }
+
+    pid_t spawn_cmd_to_file(const std::string &cmd, const std::string &fname)
+    {
+        int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        auto child = spawn_cmd(cmd, fd, fd);
+        close(fd);
+        return child;
+    }
+
+    int wait_cmd(pid_t child)
+    {
+        if (child < 0) return -1;
+        int status;
+        while (waitpid(child, &status, 0) < 0)
+        {
+            if (errno != EINTR) return -1;
+        }
+        return status;
+    }
+
+    pid_t spawn_cmd_with_pipe(const std::string &cmd, int &fd, bool nonblocking)
+    {
+        fd = -1;
+        int fds[2];
+        // close on exec so that commands launched concurrently from other threads do not
+        // inherit the pipe and keep it open
+        if (pipe2(fds, O_CLOEXEC) != 0) return -1;
+        auto child = spawn_cmd(cmd, fds[1]);
+        close(fds[1]);
+        if (child < 0) {
+            close(fds[0]);
+            return -1;
+        }
+        // only the read end, the command's output must still block when the pipe is full
+        if (nonblocking) fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        fd = fds[0];
+        return child;
+    }
+
+    // execute a command on the command line
+    std::string exec_sys_cmd(std::string cmd)
+    {
+        std::string result;
+        if (cmd.size()==0) return result;
+        int fd;
+        auto child = spawn_cmd_with_pipe(cmd, fd);
+        if (child < 0) {
+            throw std::runtime_error("posix_spawn() failed!");
+        }
+        std::array<char, 4096> buffer;
+        while (true) {
+            auto nread = read(fd, buffer.data(), buffer.size());
+            if (nread < 0 && errno == EINTR) continue;
+            if (nread <= 0) break;
+            result.append(buffer.data(), nread);
+        }
+        close(fd);
+        wait_cmd(child);
+        return result;
+    }
+
+    void CSVStreamParser::_parse_line(const char *begin, const char *end)
+    {
+        // skip blank lines
+        auto p = begin;
+        while (p < end && std::isspace(static_cast<unsigned char>(*p))) p++;
+        if (p == end) return;
+        // fields are not copied but parsed within the line, which is not null terminated
+        const char *field = begin;
+        for (int i=0;i<ncols;i++) 
+        {
+            double value = 0;
+            if (field != nullptr)
+            {
+                while (field < end && std::isspace(static_cast<unsigned char>(*field))) field++;
+                // fields that are not numbers, such as [N/A], are zero
+                if (std::from_chars(field, end, value).ec != std::errc()) value = 0;
+                field = static_cast<const char *>(std::memchr(field, ',', end - field));
+                if (field != nullptr) field++;
+            }
+            record.push_back(value);
+        }
+        if (record.size() == static_cast<size_t>(nrows * ncols)) 
+        {
+            records.push_back(std::move(record));
+            record.clear();
+        }
+    }
+
+    void CSVStreamParser::Append(const char *data, size_t size)
+    {
+        const char *end = data + size;
+        while (data < end) 
+        {
+            auto newline = static_cast<const char *>(std::memchr(data, '\n', end - data));
+            if (newline == nullptr) 
+            {
+                partial.append(data, end);
+                return;
+            }
+            if (partial.empty()) _parse_line(data, newline);
+            else 
+            {
+                partial.append(data, newline);
+                _parse_line(partial.data(), partial.data() + partial.size());
+                partial.clear();
+            }
+            data = newline + 1;
+        }
+    }
+
+    bool CSVStreamParser::Pop(std::vector<double> &values)
+    {
+        if (records.empty()) return false;
+        values = std::move(records.front());
+        records.pop_front();
+        return true;
+    }
+}
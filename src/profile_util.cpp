@@ -11,10 +11,18 @@ namespace profiling_util {
         return fullpath.substr(lastSlashPos + 1);
     };
 
-    std::string __when(){
+    std::string source_location::ref() const
+    {
+        return "@"+std::string(function)+" "+file+":L"+std::to_string(line);
+    }
+
+    const char *__when(){
+        // a buffer of the thread rather than a string, so log headers do not allocate
+        thread_local char whenbuff[32];
         auto log_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-        std::string whenbuff=std::ctime(&log_time);
-        whenbuff.erase(std::find(whenbuff.begin(), whenbuff.end(), '\n'), whenbuff.end());
+        if (ctime_r(&log_time, whenbuff) == nullptr) whenbuff[0] = '\0';
+        auto newline = std::strchr(whenbuff, '\n');
+        if (newline != nullptr) *newline = '\0';
         return whenbuff;
     }
     std::string __version(){
@@ -0,0 +1,436 @@
+/*! \file region_util.cpp
+ *  \brief Region profiler accumulating the times of scoped regions in a call tree per thread
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "profile_util.h"
+
+namespace profiling_util {
+
+    using _region_clock = pu_clock;
+
+    // a region at one place in the call tree of a thread. The times are only written by the
+    // thread, and read by reports from other threads
+    struct _region_node {
+        int region;
+        _region_node *parent;
+        std::vector<_region_node *> children;
+        // the child last entered, looked at first as loops enter the same regions over and over
+        _region_node *last_child = nullptr;
+        // a node is entered at most once at a time, recursion adding nodes of its own
+        _region_clock::time_point start;
+        std::atomic<uint64_t> count{0};
+        std::atomic<Timer::duration> total{0};
+        std::atomic<Timer::duration> min{std::numeric_limits<Timer::duration>::max()};
+        std::atomic<Timer::duration> max{0};
+        std::atomic<Timer::duration> children_time{0};
+        _region_node(int _region, _region_node *_parent) : region(_region), parent(_parent) {}
+    };
+
+    // call tree of a thread, kept after the thread exits. The lock guards adding nodes
+    struct _region_tree {
+        std::mutex mtx;
+        std::vector<std::unique_ptr<_region_node>> nodes;
+        _region_node *current;
+        // measured on the thread, indexed by clock_source
+        timer_overhead overhead[2];
+        _region_tree()
+        {
+            nodes.push_back(std::make_unique<_region_node>(-1, nullptr));
+            current = nodes[0].get();
+        }
+    };
+
+    struct _region_info {
+        std::string name;
+        std::string ref;
+    };
+
+    struct _region_registry {
+        std::mutex mtx;
+        std::vector<_region_info> regions;
+        std::vector<std::unique_ptr<_region_tree>> trees;
+        bool report_at_exit = true;
+        bool reported = false;
+        bool subtract_overhead = false;
+        // measured when the library is loaded, indexed by clock_source
+        timer_overhead overhead[2];
+    };
+
+    // never destroyed, as threads can still exit regions while statics are destroyed
+    static _region_registry &_get_registry()
+    {
+        static auto registry = new _region_registry;
+        return *registry;
+    }
+
+    static thread_local _region_tree *_tree = nullptr;
+
+    static inline _region_tree &_get_tree()
+    {
+        if (_tree == nullptr)
+        {
+            auto &registry = _get_registry();
+            std::lock_guard<std::mutex> lock(registry.mtx);
+            registry.trees.push_back(std::make_unique<_region_tree>());
+            _tree = registry.trees.back().get();
+        }
+        return *_tree;
+    }
+
+    static _region_node *_add_child(_region_tree &tree, _region_node *parent, int region)
+    {
+        std::lock_guard<std::mutex> lock(tree.mtx);
+        tree.nodes.push_back(std::make_unique<_region_node>(region, parent));
+        auto child = tree.nodes.back().get();
+        parent->children.push_back(child);
+        return child;
+    }
+
+    static void _report_regions_at_exit()
+    {
+        auto &registry = _get_registry();
+        {
+            std::lock_guard<std::mutex> lock(registry.mtx);
+            if (!registry.report_at_exit || registry.reported) return;
+        }
+        auto report = ReportRegions("exit", "", "");
+#ifdef _MPI
+        std::cout << "[" << std::setw(5) << std::setfill('0') << __comm_rank << "] " << std::setw(0);
+#endif
+        std::cout << report << std::endl;
+    }
+
+    int RegisterRegion(const std::string &name, const source_location &where)
+    {
+        auto &registry = _get_registry();
+        auto ref = where.ref();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+        // inline functions can register the same region from several translation units
+        for (size_t i=0;i<registry.regions.size();i++)
+        {
+            if (registry.regions[i].name == name && registry.regions[i].ref == ref) return i;
+        }
+        if (registry.regions.empty()) std::atexit(_report_regions_at_exit);
+        registry.regions.push_back({name, ref});
+        return registry.regions.size() - 1;
+    }
+
+    void EnterRegion(int region)
+    {
+        auto &tree = _get_tree();
+        auto parent = tree.current;
+        auto child = parent->last_child;
+        if (child == nullptr || child->region != region)
+        {
+            child = nullptr;
+            for (auto c : parent->children) if (c->region == region) {child = c; break;}
+            if (child == nullptr) child = _add_child(tree, parent, region);
+            parent->last_child = child;
+        }
+        tree.current = child;
+        // read the clock last, so the lookup is not part of the time of the region
+        child->start = _region_clock::now();
+    }
+
+    void ExitRegion()
+    {
+        auto end = _region_clock::now();
+        auto &tree = _get_tree();
+        auto node = tree.current;
+        // more exits than entries are ignored
+        if (node->parent == nullptr) return;
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - node->start).count();
+        detail::_single_writer_add<uint64_t>(node->count, 1);
+        detail::_single_writer_add<Timer::duration>(node->total, time);
+        if (time < node->min.load(std::memory_order_relaxed)) node->min.store(time, std::memory_order_relaxed);
+        if (time > node->max.load(std::memory_order_relaxed)) node->max.store(time, std::memory_order_relaxed);
+        detail::_single_writer_add<Timer::duration>(node->parent->children_time, time);
+        tree.current = node->parent;
+    }
+
+    RegionReportScope::RegionReportScope(int _region, const source_location &_where)
+    : region(_region), where(_where)
+    {
+        EnterRegion(region);
+    }
+
+    RegionReportScope::~RegionReportScope()
+    {
+        ExitRegion();
+        auto report = ReportRegions(where.function, where.file, std::to_string(where.line), region);
+#ifdef _MPI
+        std::cout << "[" << std::setw(5) << std::setfill('0') << __comm_rank << "] " << std::setw(0);
+#endif
+        std::cout << report << std::endl;
+    }
+
+    // a region of the call tree merged across threads
+    struct _merged_region {
+        region_stats stats;
+        std::vector<int> children;
+    };
+
+    static inline Timer::duration _less(Timer::duration time, double overhead)
+    {
+        return std::max<Timer::duration>(0, time - static_cast<Timer::duration>(std::llround(overhead)));
+    }
+
+    // returns the number of entries of the regions below the node. With the overhead given, each
+    // entry of a region is less the part of the overhead between its reads of the clock, and
+    // every entry of a region nested within it adds all of the overhead of a region to its time
+    static uint64_t _merge_region_tree(const _region_node *node, int merged, std::vector<_merged_region> &tree, const timer_overhead *overhead)
+    {
+        uint64_t entries = 0;
+        for (auto child : node->children)
+        {
+            int index = -1;
+            for (auto c : tree[merged].children) if (tree[c].stats.region == child->region) {index = c; break;}
+            if (index < 0)
+            {
+                index = tree.size();
+                tree.emplace_back();
+                tree[index].stats.region = child->region;
+                tree[index].stats.depth = tree[merged].stats.depth + 1;
+                tree[merged].children.push_back(index);
+            }
+            auto nested = _merge_region_tree(child, index, tree, overhead);
+            auto count = child->count.load(std::memory_order_relaxed);
+            entries += count + nested;
+            if (count == 0) continue;
+            auto total = child->total.load(std::memory_order_relaxed);
+            auto children = child->children_time.load(std::memory_order_relaxed);
+            auto min = child->min.load(std::memory_order_relaxed), max = child->max.load(std::memory_order_relaxed);
+            if (overhead != nullptr)
+            {
+                uint64_t direct = 0;
+                for (auto c : child->children) direct += c->count.load(std::memory_order_relaxed);
+                total = _less(total, count * overhead->region_inner + nested * overhead->region);
+                children = _less(children, direct * overhead->region_inner + (nested - direct) * overhead->region);
+                children = std::min(children, total);
+                // the entries nested within each entry are not known, only their mean
+                auto per_entry = overhead->region_inner + static_cast<double>(nested) / count * overhead->region;
+                auto mean = total / static_cast<Timer::duration>(count);
+                min = std::min(_less(min, per_entry), mean);
+                max = std::max(_less(max, per_entry), mean);
+            }
+            auto &stats = tree[index].stats;
+            stats.min = (stats.count == 0) ? min : std::min(stats.min, min);
+            stats.max = std::max(stats.max, max);
+            stats.count += count;
+            stats.total += total;
+            stats.children += children;
+            stats.nthreads++;
+        }
+        return entries;
+    }
+
+    // depth first, with the depth relative to the subtree root when only subtrees of a region
+    // are listed, in which case the region nested within itself is part of the outer subtree
+    static void _list_regions(const std::vector<_merged_region> &tree, int index, int region, int depth, std::vector<region_stats> &list)
+    {
+        auto &node = tree[index];
+        bool listed = (index > 0) && (region < 0 || depth >= 0 || node.stats.region == region);
+        if (listed)
+        {
+            if (depth < 0) depth = 0;
+            list.push_back(node.stats);
+            list.back().depth = depth;
+        }
+        for (auto c : node.children) _list_regions(tree, c, region, listed ? depth + 1 : depth, list);
+    }
+
+    std::vector<region_stats> get_region_stats(int region)
+    {
+        auto &registry = _get_registry();
+        std::vector<_merged_region> tree(1);
+        std::vector<_region_info> regions;
+        auto source = static_cast<int>(get_clock_info().source);
+        {
+            std::lock_guard<std::mutex> lock(registry.mtx);
+            regions = registry.regions;
+            for (auto &t : registry.trees)
+            {
+                std::lock_guard<std::mutex> tree_lock(t->mtx);
+                // that of the thread if it measured it, otherwise that measured when loaded
+                const timer_overhead *overhead = nullptr;
+                if (registry.subtract_overhead)
+                {
+                    if (t->overhead[source].valid) overhead = &t->overhead[source];
+                    else if (registry.overhead[source].valid) overhead = &registry.overhead[source];
+                }
+                _merge_region_tree(t->nodes[0].get(), 0, tree, overhead);
+            }
+        }
+        std::vector<region_stats> list;
+        _list_regions(tree, 0, region, (region < 0) ? 0 : -1, list);
+        for (auto &r : list)
+        {
+            r.name = regions[r.region].name;
+            r.ref = regions[r.region].ref;
+        }
+        return list;
+    }
+
+    std::string ReportRegions(
+        const std::string &function,
+        const std::string &file,
+        const std::string &line_num,
+        int region)
+    {
+        auto list = get_region_stats(region);
+        bool subtracted;
+        {
+            auto &registry = _get_registry();
+            std::lock_guard<std::mutex> lock(registry.mtx);
+            registry.reported = true;
+            subtracted = registry.subtract_overhead;
+        }
+        std::ostringstream report;
+        if (file.empty()) report << "Region call tree at program " << function << " : ";
+        else report << "Region call tree @" << function << " " << file << ":L" << line_num << " : ";
+        report << list.size() << " regions";
+        if (subtracted) report << ", times less the overhead of the regions";
+        for (auto &r : list)
+        {
+            report << "\n" << std::string(2 * (r.depth + 1), ' ') << r.name << " " << r.ref
+                << " : count = " << r.count << ", total = " << ns_time(r.total)
+                << ", self = " << ns_time(r.self());
+            if (r.count > 0)
+            {
+                report << ", mean = " << ns_time(r.total / static_cast<Timer::duration>(r.count))
+                    << ", min = " << ns_time(r.min) << ", max = " << ns_time(r.max);
+            }
+            report << ", threads = " << r.nthreads;
+        }
+        return report.str();
+    }
+
+    void SetRegionReportAtExit(bool report)
+    {
+        auto &registry = _get_registry();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+        registry.report_at_exit = report;
+    }
+
+    // regions entered in a tree of their own, which no report merges, taking the median of
+    // several batches as other processes sharing the core inflate some of them
+    static timer_overhead _measure_overhead()
+    {
+        constexpr int nbatches = 5, niterations = 2000;
+        timer_overhead overhead;
+        overhead.source = get_clock_info().source;
+        std::vector<double> read(nbatches), region(nbatches), region_inner(nbatches);
+        _region_tree tree;
+        auto prior = _tree;
+        _tree = &tree;
+        volatile _region_clock::rep sink = 0;
+        for (int b=0;b<nbatches;b++)
+        {
+            auto t0 = _region_clock::now();
+            for (int i=0;i<niterations;i++) sink = _region_clock::now().time_since_epoch().count();
+            auto t1 = _region_clock::now();
+            for (int i=0;i<niterations;i++)
+            {
+                EnterRegion(0);
+                ExitRegion();
+            }
+            auto t2 = _region_clock::now();
+            auto node = tree.nodes[0]->children[0];
+            read[b] = std::chrono::duration<double, std::nano>(t1 - t0).count() / niterations;
+            region[b] = std::chrono::duration<double, std::nano>(t2 - t1).count() / niterations;
+            region_inner[b] = static_cast<double>(node->total.load(std::memory_order_relaxed)) / niterations;
+            node->total.store(0, std::memory_order_relaxed);
+        }
+        _tree = prior;
+        static_cast<void>(sink);
+        auto median = [](std::vector<double> &x) {
+            std::nth_element(x.begin(), x.begin() + x.size() / 2, x.end());
+            return x[x.size() / 2];
+        };
+        overhead.read = median(read);
+        overhead.region = median(region);
+        overhead.region_inner = std::min(median(region_inner), overhead.region);
+        overhead.valid = true;
+        return overhead;
+    }
+
+    // every clock timers can read, which leaves the counter alone if it was not calibrated
+    static bool _calibrate_timer_overhead_at_load()
+    {
+        auto info = get_clock_info();
+        timer_overhead overhead[2];
+        for (auto source : {clock_source::steady, clock_source::tsc})
+        {
+            if (source == clock_source::tsc && (!info.tsc_usable || info.tsc_ghz == 0)) continue;
+            SetClockSource(source);
+            overhead[static_cast<int>(source)] = _measure_overhead();
+        }
+        SetClockSource(info.source);
+        auto &registry = _get_registry();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+        for (int i=0;i<2;i++) registry.overhead[i] = overhead[i];
+        return true;
+    }
+    static const bool _timer_overhead_calibrated = _calibrate_timer_overhead_at_load();
+
+    timer_overhead CalibrateTimerOverhead()
+    {
+        auto overhead = _measure_overhead();
+        auto &tree = _get_tree();
+        std::lock_guard<std::mutex> lock(tree.mtx);
+        tree.overhead[static_cast<int>(overhead.source)] = overhead;
+        return overhead;
+    }
+
+    timer_overhead get_timer_overhead(clock_source source)
+    {
+        auto index = static_cast<int>(source);
+        if (_tree != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(_tree->mtx);
+            if (_tree->overhead[index].valid) return _tree->overhead[index];
+        }
+        auto &registry = _get_registry();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+        auto overhead = registry.overhead[index];
+        overhead.source = source;
+        return overhead;
+    }
+
+    void SetRegionOverheadSubtraction(bool subtract)
+    {
+        auto &registry = _get_registry();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+        registry.subtract_overhead = subtract;
+    }
+
+    std::string ReportTimerOverhead()
+    {
+        auto info = get_clock_info();
+        std::ostringstream report;
+        report << "Timer overhead \n ======== \n";
+        for (auto source : {clock_source::steady, clock_source::tsc})
+        {
+            auto overhead = get_timer_overhead(source);
+            if (source == clock_source::steady) report << "steady_clock";
+            else if (info.tsc_ghz > 0) report << "TSC at " << info.tsc_ghz << " GHz";
+            else report << "TSC";
+            if (source == info.source) report << " (in use)";
+            if (!overhead.valid)
+            {
+                report << " : not measured";
+                if (source == clock_source::tsc && !info.tsc_usable) report << ", " << info.tsc_reason;
+            }
+            else
+            {
+                report << " : read = " << overhead.read << " ns, region enter and exit = " << overhead.region
+                    << " ns, of which " << overhead.region_inner << " ns within the region";
+            }
+            report << "\n";
+        }
+        return report.str();
+    }
+}
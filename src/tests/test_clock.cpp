@@ -0,0 +1,87 @@
+/*!
+    \file test_clock.cpp
+    \brief Benchmark the clocks timers can read and check the calibration of the time stamp counter.
+    \details Compares the cost and resolution of steady_clock, high_resolution_clock and the
+    clock of timers reading the time stamp counter and steady_clock. Where the counter is usable,
+    it must be cheaper to read than steady_clock and agree with it over an interval, and timers
+    must keep their times when the clock is swapped.
+    Usage: test_clock [number of reads]
+*/
+
+#include <profile_util.h>
+
+// cost per read [ns] and smallest nonzero difference of successive reads [ns]
+template <typename Clock>
+std::pair<double, double> clock_cost(int nreads)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    auto prior = Clock::now();
+    typename Clock::duration resolution = Clock::duration::max();
+    for (int i=0;i<nreads;i++)
+    {
+        auto now = Clock::now();
+        if (now > prior) resolution = std::min(resolution, now - prior);
+        prior = now;
+    }
+    double cost = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / nreads;
+    return {cost, std::chrono::duration<double, std::nano>(resolution).count()};
+}
+
+void report_clock(const std::string &name, std::pair<double, double> cost)
+{
+    Log()<<name<<" : "<<cost.first<<" ns per read, resolution "<<cost.second<<" ns"<<std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    int nreads = 1000000;
+    if (argc > 1) nreads = atoi(argv[1]);
+    LogParallelAPI();
+    auto info = profiling_util::get_clock_info();
+    Log()<<"TSC "<<(info.tsc_usable ? "usable" : "not usable, " + info.tsc_reason)
+        <<", calibrated at "<<info.tsc_ghz<<" GHz over "<<profiling_util::ns_time(info.calibration_time)
+        <<", timers reading "<<(info.source == profiling_util::clock_source::tsc ? "tsc" : "steady_clock")<<std::endl;
+
+    report_clock("steady_clock", clock_cost<std::chrono::steady_clock>(nreads));
+    report_clock("high_resolution_clock", clock_cost<std::chrono::high_resolution_clock>(nreads));
+    profiling_util::SetClockSource(profiling_util::clock_source::steady);
+    auto steady = clock_cost<profiling_util::pu_clock>(nreads);
+    report_clock("pu_clock reading steady_clock", steady);
+    bool ok = true;
+    if (profiling_util::SetClockSource(profiling_util::clock_source::tsc))
+    {
+        auto tsc = clock_cost<profiling_util::pu_clock>(nreads);
+        report_clock("pu_clock reading the TSC", tsc);
+        ok = ok && tsc.first <= steady.first * 1.1;
+
+        // the counter must agree with steady_clock over an interval
+        auto s0 = std::chrono::steady_clock::now();
+        auto t0 = profiling_util::pu_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto t1 = profiling_util::pu_clock::now();
+        auto s1 = std::chrono::steady_clock::now();
+        double tsc_interval = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        double steady_interval = std::chrono::duration<double, std::nano>(s1 - s0).count();
+        double error = std::abs(tsc_interval - steady_interval) / steady_interval;
+        Log()<<"Interval of "<<profiling_util::ns_time(steady_interval)<<" differs by "<<error * 1e6<<" ppm"<<std::endl;
+        ok = ok && error < 1e-3;
+
+        // a timer started on the counter keeps its time when swapped to steady_clock
+        auto timer = NewTimer();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        profiling_util::SetClockSource(profiling_util::clock_source::steady);
+        auto elapsed = timer.get();
+        LogTimeTaken(timer);
+        ok = ok && elapsed >= 9000000 && elapsed < 100000000;
+    }
+    else ok = ok && !info.tsc_usable;
+    Log()<<"Clocks : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
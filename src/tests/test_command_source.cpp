@@ -0,0 +1,55 @@
+/*!
+    \file test_command_source.cpp
+    \brief Test a command sampled more often than it takes to run does not hold up other metrics.
+    \details A slow command, a fast command and a synthetic source are sampled by the same sampler.
+    The synthetic source must keep close to the requested rate while the slow command runs, the
+    slow command must report its value about once per run with the samples it overran counted, and
+    the fast command must report its values every few samples.
+    Usage: test_command_source [sample period in seconds] [run time of the slow command in seconds]
+*/
+
+#include <profile_util.h>
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    float period = 0.02, slow = 0.2;
+    if (argc > 1) period = atof(argv[1]);
+    if (argc > 2) slow = atof(argv[2]);
+    double duration = 5 * slow;
+    auto s = NewGeneralSampler(period);
+    s.AddSource(std::make_shared<profiling_util::SyntheticSource>("synthetic", "s", 
+        [](double time) {return time;}));
+    auto slow_cmd = std::make_shared<profiling_util::CommandSource>("slow_cmd", "none", "sleep " + std::to_string(slow) + "; echo 3");
+    auto fast_cmd = std::make_shared<profiling_util::CommandSource>("fast_cmd", "none", "printf '5\\n6\\n'", 2);
+    s.AddSource(slow_cmd);
+    s.AddSource(fast_cmd);
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    s.Pause();
+    LogSamplerTiming(s);
+
+    std::vector<double> times, values;
+    s.GetSamples("synthetic", times, values);
+    std::size_t expected = duration / period;
+    bool ok = times.size() >= expected / 2;
+    Log()<<"Synthetic source sampled "<<times.size()<<" times of "<<expected<<" : "<<(ok ? "passed" : "failed")<<std::endl;
+
+    // a run spans several periods, its samples are a run apart
+    s.GetSamples("slow_cmd", times, values);
+    bool slow_ok = times.size() >= 2 && times.size() <= duration / slow + 1 && slow_cmd->GetNumOverruns() > 0;
+    for (std::size_t i=0;i<times.size();i++) slow_ok = slow_ok && values[i] == 3 && (i == 0 || times[i] - times[i-1] >= slow);
+    Log()<<"Slow command sampled "<<times.size()<<" times with "<<slow_cmd->GetNumOverruns()<<" overruns : "<<(slow_ok ? "passed" : "failed")<<std::endl;
+
+    s.GetSamples("fast_cmd", times, values);
+    bool fast_ok = times.size() >= expected / 4;
+    for (std::size_t i=0;i<times.size();i++) fast_ok = fast_ok && values[2*i] == 5 && values[2*i+1] == 6;
+    Log()<<"Fast command sampled "<<times.size()<<" times with "<<fast_cmd->GetNumOverruns()<<" overruns : "<<(fast_ok ? "passed" : "failed")<<std::endl;
+    ok = ok && slow_ok && fast_ok;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
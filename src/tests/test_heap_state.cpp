@@ -0,0 +1,53 @@
+/*!
+    \file test_heap_state.cpp
+    \brief Test the report of the state of the glibc allocator and trimming it.
+    \details Frees the large temporaries allocated between small blocks that are kept, which leaves
+    the freed memory in holes the allocator does not return to the system. The report must 
+    show the fragmentation and malloc_trim must lower the RSS. 
+    Usage: test_heap_state [MiB of temporaries]
+*/
+
+#include <profile_util.h>
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    size_t size = 256;
+    if (argc > 1) size = atol(argv[1]);
+    LogParallelAPI();
+    LogHeapState();
+
+    // temporaries below the mmap threshold, each followed by a block that is kept
+    const size_t temporary = 64 * 1024, n = size * 1024 * 1024 / temporary;
+    std::vector<char *> temporaries(n), kept(n);
+    for (size_t i=0;i<n;i++)
+    {
+        temporaries[i] = static_cast<char *>(malloc(temporary));
+        memset(temporaries[i], 1, temporary);
+        kept[i] = static_cast<char *>(malloc(64));
+        kept[i][0] = 1;
+    }
+    for (auto &t : temporaries) free(t);
+    LogMemUsage();
+    auto [report, state] = profiling_util::GetHeapState(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__));
+    Log()<<report<<std::endl;
+    auto before = profiling_util::get_memory_usage(false);
+    LogHeapTrim();
+    auto after = profiling_util::get_memory_usage(false);
+    for (auto &k : kept) free(k);
+
+    // the freed temporaries are most of the arenas, in holes, until trimmed
+    double mib = 1024.0 * 1024.0;
+    bool ok = state.valid && state.fragmentation() > 0.5 && state.free_bytes >= n * temporary 
+        && state.arenas.size() > 0 && state.arenas[0].free_bytes > 0
+        && before.rss.current >= after.rss.current + size / 2 * mib;
+    Log()<<"Heap state with "<<state.fragmentation() * 100.0<<"% fragmentation, trimming released "
+        <<(static_cast<double>(before.rss.current) - after.rss.current) / mib<<" MiB : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
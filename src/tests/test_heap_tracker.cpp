@@ -0,0 +1,78 @@
+/*!
+    \file test_heap_tracker.cpp
+    \brief Test the heap allocation tracker, which the test is linked with.
+    \details A loop whose iterations make a known number of allocations in a region marked by 
+    a timer, which must be reported per iteration and attributed to the region and loop. 
+    Creating timers and the headers of log lines must not allocate.
+    Usage: test_heap_tracker [number of iterations]
+*/
+
+#include <profile_util.h>
+
+// three allocations per call, a vector, a string too long for the small string buffer and a 
+// malloc of a buffer, which escapes so that the compiler does not elide the malloc and free
+char *volatile last_buffer = nullptr;
+__attribute__((noinline)) size_t churn(size_t i)
+{
+    std::vector<double> values(16 + i % 16, 1.0);
+    std::string text(64, 'a' + i % 26);
+    auto buffer = static_cast<char *>(malloc(256));
+    buffer[0] = text[0];
+    last_buffer = buffer;
+    size_t result = values.size() + buffer[0];
+    free(buffer);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    size_t niterations = 100000;
+    if (argc > 1) niterations = atol(argv[1]);
+    LogParallelAPI();
+
+    auto prior = profiling_util::get_heap_stats();
+    auto loop = NewTimer();
+    profiling_util::SetHeapRegion(loop);
+    volatile size_t sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i=0;i<niterations;i++) sum += churn(i);
+    double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / niterations;
+    profiling_util::ClearHeapRegion();
+    LogHeapStatsPerIteration(prior, niterations);
+    LogHeapStats();
+
+    // exactly the allocations of the loop should be attributed to its region 
+    auto stats = profiling_util::get_heap_stats();
+    bool ok = stats.active;
+    for (auto &r : stats.regions) if (r.name == loop.get_ref()) ok = ok && r.count == 3 * niterations;
+    for (auto &r : prior.regions) ok = ok && r.name != loop.get_ref();
+    ok = ok && stats.count - prior.count >= 3 * niterations && stats.sites.size() > 0 && stats.sites[0].count >= niterations;
+    Log()<<"Heap tracker with "<<time<<" ns per iteration of 3 allocations : "<<(ok ? "passed" : "failed")<<std::endl;
+
+    // creating timers, lapping them and the headers of log lines must not allocate, the stream
+    // discarding the output so that only the allocations of the timers and headers are counted
+    auto creation = NewTimer();
+    auto lapped = NewTimer();
+    lapped.set_laps();
+    profiling_util::SetHeapRegion(creation);
+    std::ostream discard(nullptr);
+    for (size_t i=0;i<1000;i++)
+    {
+        auto t = NewTimer();
+        discard<<_log_header<<t.get()<<lapped.lap();
+    }
+    profiling_util::ClearHeapRegion();
+    stats = profiling_util::get_heap_stats();
+    bool creation_ok = true;
+    for (auto &r : stats.regions) if (r.name == creation.get_ref()) creation_ok = false;
+    Log()<<"Timer creation, laps and log headers without allocations : "<<(creation_ok ? "passed" : "failed")<<std::endl;
+    ok = ok && creation_ok;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*!
+    \file test_io_sampler.cpp
+    \brief Test the IO sampler with a known amount of data written and synced to a file.
+    \details The IO counters of the process must have grown by at least the bytes and write
+    calls made, as must the totals of the report, and the sampled write bandwidth integrated
+    over the sample periods must account for the bytes written.
+    Usage: test_io_sampler [MiB to write] [number of writes]
+*/
+
+#include <profile_util.h>
+#include <fcntl.h>
+
+// the total of a report, such as "written (MiB) = "
+double report_total(const std::string &report, const std::string &name)
+{
+    auto pos = report.find(name);
+    if (pos == std::string::npos) return -1;
+    return std::stod(report.substr(pos + name.size()));
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    std::size_t mib = 16, nwrites = 64;
+    if (argc > 1) mib = atol(argv[1]);
+    if (argc > 2) nwrites = atol(argv[2]);
+    std::size_t bytes = mib * 1024 * 1024, chunk = bytes / nwrites;
+    bytes = chunk * nwrites;
+    std::vector<char> data(chunk, 'x');
+    std::string fname = ".test_io_sampler." + std::to_string(getpid()) + ".dat";
+    bool ok = true;
+
+    auto start = profiling_util::get_io_counters();
+    if (!start.valid)
+    {
+        Log()<<"IO counters of /proc/self/io not available, nothing to check"<<std::endl;
+#ifdef _MPI
+        MPI_Finalize();
+#endif
+        return 0;
+    }
+    auto sampler = NewIOSampler(0.05);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    ok = ok && fd >= 0;
+    for (std::size_t i=0;ok && i<nwrites;i++) ok = ok && write(fd, data.data(), chunk) == static_cast<ssize_t>(chunk);
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    // so the samples cover the writes
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto current = profiling_util::get_io_counters();
+    auto report = profiling_util::ReportIOStats(sampler, __func__, _PU_FILE, std::to_string(__LINE__));
+    sampler.Pause();
+    std::filesystem::remove(fname);
+    Log()<<report<<std::endl;
+
+    ok = ok && current.wchar - start.wchar >= bytes && current.syscw - start.syscw >= nwrites;
+    double written = report_total(report, "written (MiB) = "), calls = report_total(report, "write calls = ");
+    // the report prints 6 significant digits
+    ok = ok && written * 1024 * 1024 >= 0.999 * bytes && calls >= nwrites;
+
+    // the rate of each sample is over the period since the sample before
+    std::vector<double> times, rates;
+    sampler.GetSamples(sampler.GetIOWriteFname(), times, rates);
+    double sampled = 0;
+    for (std::size_t i=1;i<times.size();i++) sampled += rates[2*i] * (times[i] - times[i-1]) * 1024 * 1024;
+    ok = ok && sampled >= 0.9 * bytes && sampled <= 2.0 * bytes;
+    Log()<<"Wrote "<<bytes<<" bytes in "<<nwrites<<" calls, counted "<<current.wchar - start.wchar<<" bytes in "
+        <<current.syscw - start.syscw<<" calls, reported "<<written<<" MiB in "<<calls<<" calls, sampled "<<sampled
+        <<" bytes : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+/*!
+    \file test_mem_usage.cpp
+    \brief Benchmark the overhead of tracking the memory usage of the process every step of a loop.
+    \details Checks the current usage read from /proc/self/statm follows the resident set as it grows 
+    and times it against the full status, including peaks, read from /proc/self/status. 
+    Usage: test_mem_usage [number of steps]
+*/
+
+#include <profile_util.h>
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    int nsteps = 1000000;
+    if (argc > 1) nsteps = atoi(argv[1]);
+    LogParallelAPI();
+    LogMemUsage();
+    auto start = profiling_util::get_memory_usage(false);
+
+    // each step touches a new page of uninitialised memory so that the resident set grows
+    const size_t page = 4096;
+    int ngrow = std::min(nsteps, 65536);
+    std::unique_ptr<char[]> memory(new char[ngrow * page]);
+    size_t peak = 0;
+    for (int i=0;i<ngrow;i++) 
+    {
+        memory[i * page] = 1;
+        peak = std::max(peak, profiling_util::get_memory_usage(false).rss.current);
+    }
+
+    // the overhead is the cpu time of the calls, which is not inflated by sharing cores with other ranks
+    auto cputime = []() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+    };
+    auto t0 = cputime();
+    for (int i=0;i<nsteps;i++) peak = std::max(peak, profiling_util::get_memory_usage(false).rss.current);
+    double current = (cputime() - t0) / nsteps;
+    int nfull = std::max(nsteps / 100, 1);
+    t0 = cputime();
+    for (int i=0;i<nfull;i++) profiling_util::get_memory_usage();
+    double full = (cputime() - t0) / nfull;
+    LogMemUsage();
+
+    auto usage = profiling_util::get_memory_usage();
+    bool ok = peak >= start.rss.current + ngrow * page / 2 && peak <= usage.rss.peak && current < 1.0;
+    Log()<<"Memory usage query cpu time (us) over "<<nsteps<<" steps : statm = "<<current<<" status = "<<full
+        <<" : peak RSS tracked "<<profiling_util::memory_amount(peak)<<" : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+/*!
+    \file test_memory_sampler.cpp
+    \brief Test attributing the peak memory usage to the region of code in which it occurred.
+    \details Two regions, each marked by a timer, allocate different amounts of memory
+    while sampled by a MemorySampler. The peak RSS must be attributed to the region 
+    allocating the most.
+*/
+
+#include <profile_util.h>
+
+// touch memory so that it is resident, holding it for a time so that it is sampled
+void allocate(size_t mib, int ms)
+{
+    std::vector<char> memory(mib * 1024 * 1024, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    LogMemUsage();
+}
+
+int main()
+{
+#ifdef _MPI
+    MPI_Init(nullptr, nullptr);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    LogParallelAPI();
+    auto s = NewMemorySampler(0.005);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto small = NewTimer();
+    s.SetActiveTimer(small);
+    allocate(64, 100);
+    auto large = NewTimer();
+    s.SetActiveTimer(large);
+    allocate(256, 100);
+    s.ClearActiveTimer();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LogMemoryPeaks(s);
+
+    // the sample with the largest RSS should be tagged with the region of the large allocation
+    std::vector<double> times, values, region_times, region_values;
+    s.GetSamples(s.GetMemFname(), times, values);
+    s.GetSamples(s.GetMemRegionFname(), region_times, region_values);
+    auto regions = s.GetRegions();
+    size_t ipeak = 0;
+    for (size_t i=0;i<times.size();i++) if (values[i*5] > values[ipeak*5]) ipeak = i;
+    bool ok = times.size() > 10 && ipeak < region_values.size() && region_times[ipeak] == times[ipeak]
+        && regions[static_cast<size_t>(region_values[ipeak])] == large.get_ref();
+    Log()<<"Peak RSS of "<<values[ipeak*5]<<" MiB attributed to "<<regions[static_cast<size_t>(region_values[ipeak])]
+        <<" : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
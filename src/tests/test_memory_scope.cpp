@@ -0,0 +1,45 @@
+/*!
+    \file test_memory_scope.cpp
+    \brief Test measuring the peak memory of a phase after an earlier larger phase.
+    \details An outer scope encloses a large phase followed by a small phase measured 
+    by an inner scope. The inner scope must report the peak of the small phase, while 
+    the outer scope and the process must still report the peak of the large phase.
+*/
+
+#include <profile_util.h>
+
+// touch memory so that it is resident, holding it long enough to be sampled where the peak cannot be reset
+void allocate(size_t mib)
+{
+    std::vector<char> memory(mib * 1024 * 1024, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+int main()
+{
+#ifdef _MPI
+    MPI_Init(nullptr, nullptr);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    LogParallelAPI();
+    const size_t mib = 1024 * 1024;
+    auto outer = NewMemoryScope();
+    allocate(256);
+    LogScopeMemUsage(outer);
+    auto inner = NewMemoryScope();
+    allocate(64);
+    LogScopeMemUsage(inner);
+    LogScopeMemUsage(outer);
+    LogMemUsage();
+
+    auto start = inner.GetStart().rss.current;
+    auto small = inner.GetUsage().rss.peak, large = outer.GetUsage().rss.peak;
+    auto lifetime = profiling_util::get_memory_usage().rss.peak;
+    bool ok = small >= start + 60 * mib && small < start + 128 * mib && large >= 256 * mib && lifetime + mib >= large;
+    Log()<<"Peak RSS (MiB) of the small phase = "<<small / mib<<" of the large phase = "<<large / mib
+        <<(inner.GetPeakReset() ? " reset" : " sampled")<<" : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
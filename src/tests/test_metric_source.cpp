@@ -0,0 +1,76 @@
+/*!
+    \file test_metric_source.cpp
+    \brief Test sampling and reporting of metric sources added to a sampler.
+    \details Uses a deterministic synthetic power source, whose energy is known exactly,
+    and an application defined source reporting the depth of a work queue. A source pausing
+    its own sampler must stop being sampled.
+*/
+
+#include <profile_util.h>
+
+int main()
+{
+#ifdef _MPI
+    MPI_Init(nullptr, nullptr);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    LogParallelAPI();
+    auto s = NewGeneralSampler(0.01);
+
+    // linear power ramp of two devices, integrated exactly by the trapezoidal rule
+    s.AddSource(std::make_shared<profiling_util::SyntheticSource>("synthetic_power", "W", 2,
+        [](double time, double *values) {
+            values[0] = 100.0 + 10.0 * time;
+            values[1] = 200.0;
+        }));
+    // application metric registered by the user
+    std::atomic<int> queue_depth{0};
+    s.AddSource(std::make_shared<profiling_util::FunctionSource>("queue_depth", "tasks",
+        [&queue_depth]() {return static_cast<double>(queue_depth.load());}));
+
+    for (int i=0;i<10;i++)
+    {
+        queue_depth = i;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    LogMetric(s, "synthetic_power");
+    LogMetric(s, "queue_depth");
+    LogSamplerTiming(s);
+
+    // every sample should follow the synthetic function at its time
+    std::vector<double> times, values;
+    s.GetSamples("synthetic_power", times, values);
+    bool ok = times.size() > 10;
+    for (size_t i=0;i<times.size();i++)
+    {
+        ok = ok && std::abs(values[2*i] - (100.0 + 10.0 * times[i])) < 1e-9 && values[2*i+1] == 200.0;
+    }
+    double expected = 0;
+    if (times.size() > 1) expected = 100.0 * (times.back() - times.front()) + 5.0 * (times.back() * times.back() - times.front() * times.front());
+    double energy = profiling_util::integrate_samples(times, values, 0, 2);
+    ok = ok && std::abs(energy - expected) < 1e-6 * expected;
+    // the running totals used by reports agree with the samples
+    profiling_util::sample_totals totals;
+    s.GetTotals("synthetic_power", totals);
+    ok = ok && totals.count >= times.size() && std::abs(totals.values[0].integral - (100.0 * (totals.last_time - totals.first_time) 
+        + 5.0 * (totals.last_time * totals.last_time - totals.first_time * totals.first_time))) < 1e-6 * expected;
+    Log()<<"Synthetic energy (J) = "<<energy<<" expected = "<<expected<<" : "<<(ok ? "passed" : "failed")<<std::endl;
+
+    // a source pausing its own sampler from the scheduler thread must not wait for itself
+    auto paused = NewGeneralSampler(0.01);
+    int ncalls = 0;
+    paused.AddSource(std::make_shared<profiling_util::FunctionSource>("pausing", "calls",
+        [&paused, &ncalls]() {
+            if (++ncalls == 5) paused.Pause();
+            return static_cast<double>(ncalls);
+        }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    paused.GetSamples("pausing", times, values);
+    bool paused_ok = ncalls == 5 && times.size() == 5 && profiling_util::SamplerScheduler::Get().GetNumTasks() == 2;
+    Log()<<"Source pausing its sampler called "<<ncalls<<" times : "<<(paused_ok ? "passed" : "failed")<<std::endl;
+    ok = ok && paused_ok;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
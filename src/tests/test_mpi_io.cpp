@@ -129,9 +129,11 @@ int main(int argc, char *argv[]) {
     MPILog0NodeSystemMem();
     MPI_Barrier(comm);
 
-    // trial some writes 
+    // trial some writes, sampling the IO of each rank
+    auto sio = NewIOSampler(0.1);
     WriteCollective(comm,opt.basefilename, opt.msize);
     WriteNonCollective(comm,opt.basefilename, opt.msize);
+    LogIOStats(sio);
 
     // finish job
     Rank0Log()<<"Ending job"<<std::endl;
@@ -0,0 +1,81 @@
+/*!
+    \file test_mpi_node_mem.cpp
+    \brief Test the node memory report counts memory shared by the ranks on a node once.
+    \details The ranks on each node map and touch a shared memory window. The sum of their 
+    RSS counts the window once per rank, the sum of their PSS only once. The root must get 
+    the usage of each node, and the system memory of each node, and the summary of the usage of
+    the ranks must single out the rank using the most memory.
+    Usage: test_mpi_node_mem [window size in MiB]
+*/
+
+#include <profile_util.h>
+#include <mpi.h>
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+    size_t window_mib = 256;
+    if (argc > 1) window_mib = atol(argv[1]);
+    const size_t mib = 1024 * 1024;
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    // the window is allocated by the node leader and touched by all ranks
+    char *base;
+    MPI_Win win;
+    MPI_Aint size = (node_rank == 0) ? window_mib * mib : 0;
+    MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, node_comm, &base, &win);
+    MPI_Aint leader_size;
+    int disp;
+    MPI_Win_shared_query(win, 0, &leader_size, &disp, &base);
+    if (node_rank == 0) std::fill(base, base + leader_size, 1);
+    MPI_Barrier(node_comm);
+    volatile size_t sum = 0;
+    for (MPI_Aint i=0;i<leader_size;i+=4096) sum += base[i];
+    // the last rank uses far more memory of its own, to stand out of the distribution of the ranks
+    int commsize;
+    MPI_Comm_size(MPI_COMM_WORLD, &commsize);
+    std::vector<char> extra((profiling_util::__comm_rank == commsize - 1) ? window_mib * mib : 0, 1);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    auto [report, nodes, mems] = profiling_util::MPIGetNodeMemUsage(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__));
+    int ok = 1;
+    if (profiling_util::__comm_rank == 0) 
+    {
+        Log()<<report<<std::endl;
+        // the RSS sums count the window on each rank of the node, the PSS sums once
+        for (auto &m : mems) ok = ok && (node_size == 1 || m.pss + (node_size - 1) * window_mib * mib / 2 < m.rss.current);
+        Log()<<"Node PSS counts the shared window once : "<<(ok ? "passed" : "failed")<<std::endl;
+    }
+    // the root gets a record per node, reduced over the ranks of the node and gathered from the node leaders
+    auto &comms = profiling_util::MPIGetNodeComms(profiling_util::__comm);
+    auto [sys_report, sys_nodes, sys_mems] = profiling_util::MPIGetNodeSystemMem(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__));
+    if (profiling_util::__comm_rank == 0) 
+    {
+        Log()<<sys_report<<std::endl;
+        bool nodes_ok = static_cast<int>(nodes.size()) == comms.nnodes && static_cast<int>(sys_nodes.size()) == comms.nnodes;
+        Log()<<"Node reports of "<<comms.nnodes<<" nodes : "<<(nodes_ok ? "passed" : "failed")<<std::endl;
+        ok = ok && nodes_ok;
+    }
+    // the summary is reduced, the root getting the distributions and outliers only
+    auto [summary_report, summary] = profiling_util::MPIGetNodeMemUsageSummary(profiling_util::__comm, __func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), 2);
+    if (profiling_util::__comm_rank == 0) 
+    {
+        Log()<<summary_report<<std::endl;
+        auto &r = summary.rank_rss;
+        bool summary_ok = r.count == commsize && summary.node_rss.count == comms.nnodes
+            && r.min <= r.p50 && r.p50 <= r.p90 && r.p90 <= r.p99 && r.p99 <= r.max 
+            && (commsize == 1 || (r.outliers.size() == 2 && r.outliers[0].value == r.max && r.outliers[0].rank == commsize - 1));
+        Log()<<"Node memory summary of "<<commsize<<" ranks : "<<(summary_ok ? "passed" : "failed")<<std::endl;
+        ok = ok && summary_ok;
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Win_free(&win);
+    MPI_Comm_free(&node_comm);
+    MPI_Finalize();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+/*!
+    \file test_mpi_node_sampler.cpp
+    \brief Test node level sources are sampled by the node leader only and read by all ranks on the node.
+    \details The ranks add a synthetic source whose values are its time and the rank sampling it
+    as a node level source. Only the node leader may call the source, and the samples every rank
+    gets must be the leader's, with values consistent with their time.
+    Usage: test_mpi_node_sampler [sample period in seconds]
+*/
+
+#include <profile_util.h>
+#include <mpi.h>
+
+// calls of the source in this process
+std::atomic<int> ncalls{0};
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+    float period = 0.01;
+    if (argc > 1) period = atof(argv[1]);
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    int node_rank, leader = profiling_util::__comm_rank;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Bcast(&leader, 1, MPI_INT, 0, node_comm);
+
+    int ok = 1;
+    {
+        auto s = NewGeneralSampler(period);
+        int rank = profiling_util::__comm_rank;
+        auto source = std::make_shared<profiling_util::SyntheticSource>("node_synthetic", "none", 2,
+            [rank](double time, double *values) {
+                ncalls++;
+                values[0] = time;
+                values[1] = rank;
+            });
+        MPI_Comm comm = MPI_COMM_WORLD;
+        s.AddNodeSources(comm, {source});
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(period * 20000)));
+        std::vector<double> times, values;
+        bool found = s.GetSamples("node_synthetic", times, values);
+        // samples are records of a time and a width of 2 values
+        bool samples_ok = found && times.size() >= 2 && values.size() == 2 * times.size();
+        for (size_t i=0;samples_ok && i<times.size();i++) 
+        {
+            samples_ok = values[2*i] == times[i] && values[2*i+1] == leader;
+        }
+        bool calls_ok = s.GetIsNodeSampler() == (node_rank == 0) && (node_rank == 0 ? ncalls > 0 : ncalls == 0);
+        Log()<<"Node rank "<<node_rank<<" read "<<times.size()<<" samples of rank "<<leader<<" after "<<ncalls
+            <<" calls of its source : "<<(samples_ok && calls_ok ? "passed" : "failed")<<std::endl;
+        ok = samples_ok && calls_ok;
+        // the leader must still be sampling while the others read
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    MPI_Comm_free(&node_comm);
+    MPI_Finalize();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+/*!
+    \file test_numa_placement.cpp
+    \brief Test the report of the NUMA placement of memory touched first by the threads of a team.
+    \details An array first touched in a parallel loop with a static schedule must be present and 
+    local to each thread, while a buffer that is never touched must have no pages present. 
+    Usage: test_numa_placement [MiB]
+*/
+
+#include <profile_util.h>
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    size_t size = 64;
+    if (argc > 1) size = atol(argv[1]);
+    LogParallelAPI();
+    const size_t n = size * 1024 * 1024 / sizeof(double);
+
+    // first touch by the thread that uses each part of the array
+    auto data = new double[n];
+    #pragma omp parallel for schedule(static)
+    for (size_t i=0;i<n;i++) data[i] = i;
+    LogNUMAPlacement(data, n * sizeof(double));
+    auto touched = profiling_util::get_numa_placement(data, n * sizeof(double));
+
+    // large enough to be mapped by malloc without being touched, but for the header of its first page
+    auto untouched = static_cast<char *>(malloc(n * sizeof(double)));
+    LogNUMAPlacement(untouched, n * sizeof(double));
+    auto placement = profiling_util::get_numa_placement(untouched, n * sizeof(double));
+
+    cpu_set_t mask;
+    (void)sched_getaffinity(0, sizeof(mask), &mask);
+    auto local = touched.pages_on(profiling_util::get_numa_nodes(mask));
+    size_t total = 0;
+    for (auto &p : touched.node_pages) total += p;
+    bool ok = touched.valid && touched.nsampled == std::min<size_t>(1024, touched.npages) && touched.not_present == 0 && total == touched.nsampled 
+        && local == touched.nsampled && placement.valid && placement.not_present + 1 >= placement.nsampled;
+    Log()<<"NUMA placement of "<<size<<" MiB touched and untouched : "<<(ok ? "passed" : "failed")<<std::endl;
+    delete[] data;
+    free(untouched);
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+/*!
+    \file test_process_launch.cpp
+    \brief Benchmark the latency of launching commands as the resident set of the process grows.
+    \details Compares fork and exec, popen, which runs the command through the shell, and
+    exec_sys_cmd, which uses posix_spawn and runs plain commands directly.
+    Usage: test_process_launch [number of launches] [resident set sizes in MiB ...]
+*/
+
+#include <profile_util.h>
+#include <sys/wait.h>
+
+// time in micro seconds per launch of the true command
+double launch_fork(int nlaunch)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i=0;i<nlaunch;i++)
+    {
+        pid_t child = fork();
+        if (child == 0)
+        {
+            execlp("true", "true", (char*)nullptr);
+            _exit(127);
+        }
+        int status;
+        waitpid(child, &status, 0);
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / nlaunch;
+}
+
+double launch_popen(int nlaunch)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i=0;i<nlaunch;i++)
+    {
+        auto pipe = popen("true", "r");
+        pclose(pipe);
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / nlaunch;
+}
+
+double launch_spawn(int nlaunch)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i=0;i<nlaunch;i++) profiling_util::exec_sys_cmd("true");
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / nlaunch;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    int nlaunch = 100;
+    std::vector<size_t> sizes = {0, 256, 1024};
+    if (argc > 1) nlaunch = atoi(argv[1]);
+    if (argc > 2)
+    {
+        sizes.clear();
+        for (int i=2;i<argc;i++) sizes.push_back(atol(argv[i]));
+    }
+    LogParallelAPI();
+    std::vector<char> memory;
+    for (auto &size : sizes)
+    {
+        // touch the memory so that it is resident
+        memory.assign(size * 1024 * 1024, 1);
+        LogMemUsage();
+        Log()<<"Launch latency (us) with RSS of "<<size<<" MiB : fork+exec = "<<launch_fork(nlaunch)
+            <<" popen = "<<launch_popen(nlaunch)
+            <<" exec_sys_cmd = "<<launch_spawn(nlaunch)<<std::endl;
+    }
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+}
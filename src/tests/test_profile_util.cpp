@@ -48,6 +48,7 @@ int main(int argc, char *argv[])
         x = exp(-x*x)*x/(1.0+x)+sin(pow(x*x,0.25));
     }
     LogCPUUsage(s1);
+    LogSamplerTiming(s1);
     LogTimeTaken(t1);
 
 #ifdef _GPU
@@ -72,6 +73,13 @@ int main(int argc, char *argv[])
 #endif
 
 #ifdef _MPI
+    {
+        // node level metrics sampled once per node and shared with the other ranks
+        auto s_node = MPINewNodeComputeSampler(0.01);
+        sleep(1);
+        MPILogCPUUsage(s_node);
+        MPILoggerSamplerTiming(std::cout, s_node);
+    }
     MPI_Finalize();
 #endif 
 
@@ -0,0 +1,84 @@
+/*!
+    \file test_sample_buffer.cpp
+    \brief Test snapshots of the ring buffer of samplers taken while the producer overwrites it.
+    \details A producer thread pushes records whose values all equal their time into a buffer
+    of a few records, which it overwrites many times over while snapshots are taken. Every
+    record of a snapshot must be whole, with its values equal to its time, and the times of a
+    snapshot must be consecutive. The running totals must cover all records pushed, 
+    not only those retained, and be consistent whenever they are read.
+    Usage: test_sample_buffer [number of records pushed] [capacity]
+*/
+
+#include <profile_util.h>
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    std::size_t npush = 10000000, capacity = 8, width = 16;
+    if (argc > 1) npush = atol(argv[1]);
+    if (argc > 2) capacity = atol(argv[2]);
+    bool ok = true;
+
+    // without a producer, the last records are retained but for the oldest, which a snapshot
+    // drops as the producer could be overwriting it
+    profiling_util::SampleBuffer buffer(width, capacity);
+    std::vector<double> vals(width), times, values;
+    for (std::size_t i=0;i<2*capacity+3;i++)
+    {
+        std::fill(vals.begin(), vals.end(), static_cast<double>(i));
+        buffer.push(i, vals.data());
+    }
+    buffer.Snapshot(times, values);
+    ok = ok && buffer.GetNumPushed() == 2*capacity+3 && times.size() == capacity-1 && times.back() == 2*capacity+2;
+    // the totals cover the records overwritten, the integral of the value equal to the time being (N-1)^2/2
+    profiling_util::sample_totals totals;
+    buffer.GetTotals(totals);
+    double last = 2*capacity+2;
+    auto &t = totals.values[width-1];
+    ok = ok && totals.count == 2*capacity+3 && totals.values.size() == width && totals.first_time == 0 && totals.last_time == last 
+        && t.sum == last*(last+1)/2 && t.min == 0 && t.max == last && t.first == 0 && t.last == last && t.integral == last*last/2;
+    Log()<<"Totals of "<<totals.count<<" records pushed into "<<capacity<<" slots : "<<(ok ? "passed" : "failed")<<std::endl;
+
+    // with the producer overwriting the records being copied
+    profiling_util::SampleBuffer ring(width, capacity);
+    std::atomic<bool> done{false};
+    std::thread producer([&]() {
+        std::vector<double> record(width);
+        for (std::size_t i=0;i<npush;i++)
+        {
+            std::fill(record.begin(), record.end(), static_cast<double>(i));
+            ring.push(i, record.data());
+        }
+        done = true;
+    });
+    std::size_t nsnapshots = 0, nrecords = 0, ntorn = 0, nunordered = 0, ninconsistent = 0;
+    while (!done)
+    {
+        ring.Snapshot(times, values);
+        nsnapshots++;
+        nrecords += times.size();
+        ok = ok && times.size() <= capacity && values.size() == times.size() * width;
+        for (std::size_t i=0;i<times.size();i++)
+        {
+            for (std::size_t j=0;j<width;j++) if (values[i*width+j] != times[i]) {ntorn++; break;}
+            if (i > 0 && times[i] != times[i-1] + 1) nunordered++;
+        }
+        // the totals of c records of values 0 to c-1
+        ring.GetTotals(totals);
+        double c = totals.count;
+        if (c > 0 && (totals.values[0].sum != c*(c-1)/2 || totals.values[width-1].last != c-1 || totals.last_time != c-1)) ninconsistent++;
+    }
+    ring.GetTotals(totals);
+    ok = ok && totals.count == npush;
+    producer.join();
+    ok = ok && ntorn == 0 && nunordered == 0 && ninconsistent == 0 && ring.GetNumPushed() == npush;
+    Log()<<nsnapshots<<" snapshots of "<<nrecords<<" records while "<<npush<<" were pushed into "<<capacity
+        <<" slots, "<<ntorn<<" torn, "<<nunordered<<" out of order and "<<ninconsistent<<" inconsistent totals : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/*!
+    \file test_sampler_stream.cpp
+    \brief Test sampling metrics streamed by a long lived GPU monitor command.
+    \details A script printing nvidia-smi like comma separated output every --loop-ms
+    is used as the monitor so the test does not need a GPU. With a GPU build whose monitor
+    can stream, it drives the ComputeSampler, otherwise a GeneralSampler monitor stream.
+    A monitor that exits after a few records must be launched again.
+*/
+
+#include <profile_util.h>
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    int ndevices = 2;
+    float sample_time = 0.05;
+    // row i of each record is 10*i usage, 100*i+0.5 power, 1000*i memory and N/A memory usage
+    // each rank has its own script, which it removes when done
+    std::string script = ".fake_gpu_monitor." + std::to_string(getpid()) + ".sh";
+    std::ofstream(script) <<
+        "ms=1000\n"
+        "for a in \"$@\"; do case \"$a\" in --loop-ms=*) ms=\"${a#--loop-ms=}\";; esac; done\n"
+        "n=${PU_FAKE_NDEVICES:-1}\n"
+        "s=$(awk \"BEGIN{print $ms/1000.0}\")\n"
+        "while true; do\n"
+        "  i=0\n"
+        "  while [ $i -lt $n ]; do i=$((i+1)); echo \"$((10*i)), $((100*i)).5, $((1000*i)), [N/A]\"; done\n"
+        "  sleep $s\n"
+        "done\n";
+    profiling_util::SetGPUMonitorCmd("sh " + script);
+    LogParallelAPI();
+
+#if defined(_GPU) && defined(pu_gpu_stream_request)
+    pu_gpuErrorCheck(pu_gpuGetDeviceCount(&ndevices));
+    setenv("PU_FAKE_NDEVICES", std::to_string(ndevices).c_str(), 1);
+    auto s = NewComputeSampler(sample_time);
+    std::string usage_fname = s.GetGPUUsageFname();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    LogGPUUsage(s);
+    LogGPUEnergy(s);
+#else
+    setenv("PU_FAKE_NDEVICES", std::to_string(ndevices).c_str(), 1);
+    profiling_util::GeneralSampler s(__func__, profiling_util::__extract_filename(__FILE__), std::to_string(__LINE__), sample_time);
+    std::string usage_fname = "fake_gpu_usage";
+    int loop_ms = sample_time * 1000;
+    s.AddMonitorStream(profiling_util::GetGPUMonitorCmd() + " --loop-ms=" + std::to_string(loop_ms),
+        {usage_fname, "fake_gpu_power", "fake_gpu_mem", "fake_gpu_memusage"}, ndevices);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+#endif
+    LogSamplerTiming(s);
+
+    // every sample should hold the usage of each device of the fake monitor
+    std::vector<double> times, values;
+    s.GetSamples(usage_fname, times, values);
+    bool ok = times.size() > 10;
+    for (size_t i=0;i<values.size();i++) ok = ok && values[i] == 10.0*(i%ndevices+1);
+    Log()<<"Streamed "<<times.size()<<" samples of "<<ndevices<<" devices : "<<(ok ? "passed" : "failed")<<std::endl;
+
+    // a monitor exiting after a few records is launched again rather than read as a dead pipe
+    s.AddMonitorStream("printf '7\\n7\\n7\\n'", {"exiting_monitor"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    s.GetSamples("exiting_monitor", times, values);
+    bool restart_ok = times.size() > 3;
+    for (auto &v : values) restart_ok = restart_ok && v == 7.0;
+    Log()<<"Exiting monitor streamed "<<times.size()<<" samples : "<<(restart_ok ? "passed" : "failed")<<std::endl;
+    ok = ok && restart_ok;
+    std::filesystem::remove(script);
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
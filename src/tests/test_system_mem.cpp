@@ -0,0 +1,39 @@
+/*!
+    \file test_system_mem.cpp
+    \brief Benchmark the latency of querying the memory state of the system.
+    \details Compares get_system_memory, which reads /proc/meminfo directly, with running free,
+    which is how the system memory was previously queried. 
+    Usage: test_system_mem [number of calls]
+*/
+
+#include <profile_util.h>
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    int ncalls = 10000;
+    if (argc > 1) ncalls = atoi(argv[1]);
+    LogParallelAPI();
+    LogSystemMem();
+
+    // time in micro seconds per call
+    size_t total = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i=0;i<ncalls;i++) total += profiling_util::get_system_memory().total;
+    double direct = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / ncalls;
+    int nlaunch = std::max(ncalls / 1000, 1);
+    t0 = std::chrono::steady_clock::now();
+    for (int i=0;i<nlaunch;i++) profiling_util::exec_sys_cmd("free | head -n 2 | tail -n 1");
+    double launch = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / nlaunch;
+
+    bool ok = direct < 10.0 && total == ncalls * profiling_util::get_system_memory().total;
+    Log()<<"System memory query latency (us) : /proc/meminfo = "<<direct<<" free = "<<launch
+        <<" : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/*!
+    \file test_timer_laps.cpp
+    \brief Test the lap histogram of timers, recording repeated intervals to report their tail.
+    \details Percentiles of known times must be within the precision of the histogram, merging
+    histograms, of the same precision or not, must give the percentiles of the times of both,
+    and the laps of the threads of a parallel region merged must all be counted. Copies of a
+    timer must lap on their own. Recording a time must cost a few ns.
+    Usage: test_timer_laps [number of laps]
+*/
+
+#include <profile_util.h>
+
+volatile double sink = 0;
+
+__attribute__((noinline)) void work(int n)
+{
+    double sum = 0;
+    for (int i=0;i<n;i++) sum += std::sqrt(static_cast<double>(i));
+    sink = sink + sum;
+}
+
+// within the relative error of the histogram, 10^-digits
+bool close(uint64_t value, uint64_t expected, int digits)
+{
+    return std::abs(static_cast<double>(value) - static_cast<double>(expected)) <= std::pow(10.0, -digits) * expected + 1;
+}
+
+// per record [ns]
+double record_cost(profiling_util::lap_histogram &laps, int nrecords)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i=0;i<nrecords;i++) laps.record(static_cast<uint64_t>(i) * 7919 % 1000003);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / nrecords;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _MPI
+    MPI_Init(&argc, &argv);
+    MPISetLoggingComm(MPI_COMM_WORLD);
+#endif
+    int nlaps = 10000;
+    if (argc > 1) nlaps = atoi(argv[1]);
+    LogParallelAPI();
+    bool ok = true;
+
+    // times of 1 to 100000 ns, and the same in two halves merged, one of more precision
+    constexpr uint64_t ntimes = 100000;
+    profiling_util::lap_histogram all(2), first(2), second(3);
+    for (uint64_t t=1;t<=ntimes;t++)
+    {
+        all.record(t);
+        if (t % 2) first.record(t);
+        else second.record(t);
+    }
+    first.merge(second);
+    for (auto p : {50.0, 90.0, 99.0, 99.9})
+    {
+        auto expected = static_cast<uint64_t>(p / 100 * ntimes);
+        ok = ok && close(all.get_percentile(p), expected, 2) && close(first.get_percentile(p), expected, 2);
+    }
+    ok = ok && all.get_count() == ntimes && first.get_count() == ntimes;
+    ok = ok && all.get_min() == 1 && all.get_max() == ntimes && all.get_percentile(100) == ntimes;
+    ok = ok && first.get_min() == 1 && first.get_max() == ntimes && all.get_mean() == first.get_mean();
+    Log()<<profiling_util::ReportLaps(all, "1 to 100000 ns", _PU_HERE)<<std::endl;
+    Log()<<"Histogram of "<<all.get_nbuckets()<<" buckets for "<<all.get_significant_digits()<<" digits, "
+        <<second.get_nbuckets()<<" buckets for "<<second.get_significant_digits()<<" digits"<<std::endl;
+
+    // the laps of every thread merged
+    int nthreads = 1;
+    profiling_util::lap_histogram merged;
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        auto timer = NewTimer();
+        timer.set_laps();
+        for (int i=0;i<nlaps;i++)
+        {
+            work(100 + (i % 100 == 0 ? 10000 : 0));
+            timer.lap();
+        }
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        {
+#ifdef _OPENMP
+            nthreads = omp_get_num_threads();
+#endif
+            merged.merge(*timer.get_laps());
+            LogLaps(timer);
+        }
+    }
+    Log()<<profiling_util::ReportLaps(merged, "laps of all threads", _PU_HERE)<<std::endl;
+    ok = ok && merged.get_count() == static_cast<uint64_t>(nthreads * nlaps);
+    ok = ok && merged.get_min() <= merged.get_percentile(50) && merged.get_percentile(50) <= merged.get_percentile(90);
+    ok = ok && merged.get_percentile(90) <= merged.get_percentile(99) && merged.get_percentile(99) <= merged.get_percentile(99.9);
+    ok = ok && merged.get_percentile(99.9) <= merged.get_max();
+
+    // laps are recorded once the histogram is made, and a copy of a timer has laps of its own
+    auto timer = NewTimer();
+    timer.lap();
+    ok = ok && timer.get_laps() == nullptr;
+    timer.set_laps(3);
+    timer.lap();
+    auto copy = timer;
+    copy.lap();
+    copy.lap();
+    ok = ok && timer.get_laps()->get_count() == 1 && copy.get_laps()->get_count() == 3;
+    ok = ok && copy.get_laps()->get_significant_digits() == 3;
+
+    double cost = 1e9;
+    profiling_util::lap_histogram laps;
+    for (int i=0;i<5;i++) cost = std::min(cost, record_cost(laps, 1000000));
+    ok = ok && cost < 20;
+    Log()<<"Lap histogram with "<<cost<<" ns per record : "<<(ok ? "passed" : "failed")<<std::endl;
+#ifdef _MPI
+    MPI_Finalize();
+#endif
+    return ok ? 0 : 1;
+}
@@ -2,10 +2,133 @@
  *  \brief Get timing
  */
 
+#include <fcntl.h>
+#include <signal.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 #include "profile_util.h"
 
 /// get the time taken to do some comptue 
 namespace profiling_util {
+    detail::_clock_state detail::__clock{};
+
+    // whether the counter runs at a constant rate in all power states and the kernel keeps time
+    // with it, which it stops doing when it finds the counters of the cores out of step
+    static bool _tsc_usable(std::string &reason)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007 || !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) 
+        {
+            reason = "no invariant TSC leaf";
+            return false;
+        }
+        if ((edx & (1u << 8)) == 0) 
+        {
+            reason = "TSC not invariant";
+            return false;
+        }
+        std::ifstream source("/sys/devices/system/clocksource/clocksource0/current_clocksource");
+        std::string name;
+        if (source >> name && name != "tsc") 
+        {
+            reason = "kernel clocksource is " + name;
+            return false;
+        }
+        return true;
+#elif defined(__aarch64__)
+        // the generic timer runs at a constant rate
+        return true;
+#else
+        reason = "no counter on this architecture";
+        return false;
+#endif
+    }
+
+    static int64_t _steady_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // a reading of the counter and of CLOCK_MONOTONIC at the same time, the counter read either 
+    // side of the clock and the closest of a few tries kept 
+    static void _tsc_pair(uint64_t &ticks, int64_t &ns)
+    {
+        uint64_t closest = std::numeric_limits<uint64_t>::max();
+        for (int i=0;i<16;i++)
+        {
+            auto before = detail::_read_tsc();
+            auto now = _steady_ns();
+            auto after = detail::_read_tsc();
+            if (after - before >= closest) continue;
+            closest = after - before;
+            ticks = before + closest / 2;
+            ns = now;
+        }
+    }
+
+    // calibrate the counter over a few ms, which places the error of the frequency at about 1e-5
+    static bool _calibrate_tsc(clock_info &info)
+    {
+        constexpr int64_t calibration_time = 5000000;
+        uint64_t ticks0 = 0, ticks1 = 0;
+        int64_t ns0 = 0, ns1 = 0;
+        _tsc_pair(ticks0, ns0);
+        while (_steady_ns() - ns0 < calibration_time);
+        _tsc_pair(ticks1, ns1);
+        info.calibration_time = ns1 - ns0;
+        info.tsc_ghz = static_cast<double>(ticks1 - ticks0) / (ns1 - ns0);
+        if (!(info.tsc_ghz > 0) || !std::isfinite(info.tsc_ghz)) 
+        {
+            info.tsc_usable = false;
+            info.tsc_reason = "calibration failed";
+            info.tsc_ghz = 0;
+            return false;
+        }
+        detail::__clock.ns_per_tick = 1.0 / info.tsc_ghz;
+        detail::__clock.tsc0 = ticks0;
+        detail::__clock.ns0 = ns0;
+        return true;
+    }
+
+    // when the library is loaded, timers reading steady_clock until then. The counter is not 
+    // calibrated if PU_CLOCK=steady, sparing the few ms it takes
+    static clock_info _init_clock()
+    {
+        clock_info info;
+        info.tsc_usable = _tsc_usable(info.tsc_reason);
+        auto env = std::getenv("PU_CLOCK");
+        if (env != nullptr && std::strcmp(env, "steady") == 0) return info;
+        if (!info.tsc_usable || !_calibrate_tsc(info)) return info;
+        info.source = clock_source::tsc;
+        detail::__clock.use_tsc.store(true, std::memory_order_release);
+        return info;
+    }
+
+    // initialised by the first to ask for it, which can be the statics of other files
+    static clock_info &_clock_info()
+    {
+        static clock_info info = _init_clock();
+        return info;
+    }
+    static const bool _clock_initialised = (_clock_info(), true);
+
+    bool SetClockSource(clock_source source)
+    {
+        auto &info = _clock_info();
+        if (source == clock_source::tsc && (!info.tsc_usable || (info.tsc_ghz == 0 && !_calibrate_tsc(info)))) return false;
+        info.source = source;
+        detail::__clock.use_tsc.store(source == clock_source::tsc, std::memory_order_release);
+        return true;
+    }
+
+    clock_info get_clock_info()
+    {
+        return _clock_info();
+    }
+
     template <typename T>
     inline
     std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const Timer &t) {
@@ -13,20 +136,363 @@ namespace profiling_util {
         return os;
     }
 
-    void profiling_util::GeneralSampler::_launch(std::vector<std::string> requests, std::vector<std::string> fnames)
+    void SampleBuffer::Snapshot(std::vector<double> &snap_times, std::vector<double> &snap_values) const
+    {
+        auto n = header->head.load(std::memory_order_acquire);
+        std::size_t first = (n > capacity) ? n - capacity : 0;
+        snap_times.resize(n - first);
+        snap_values.resize((n - first) * width);
+        for (auto i = first; i < n; i++)
+        {
+            auto slot = i % capacity;
+            snap_times[i - first] = times[slot];
+            std::copy(values + slot * width, values + (slot + 1) * width, snap_values.begin() + (i - first) * width);
+        }
+        // records the producer may have overwritten while copying are dropped
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto n2 = header->head.load(std::memory_order_relaxed);
+        std::size_t valid = (n2 + 1 > capacity) ? n2 + 1 - capacity : 0;
+        if (valid > first) 
+        {
+            auto ndrop = std::min(valid - first, n - first);
+            snap_times.erase(snap_times.begin(), snap_times.begin() + ndrop);
+            snap_values.erase(snap_values.begin(), snap_values.begin() + ndrop * width);
+        }
+    }
+
+    void SampleBuffer::GetTotals(sample_totals &snap_totals) const
+    {
+        snap_totals.values.resize(width);
+        while (true)
+        {
+            auto seq = header->totals_seq.load(std::memory_order_acquire);
+            if (seq % 2 == 0) 
+            {
+                snap_totals.count = header->count;
+                snap_totals.first_time = header->first_time;
+                snap_totals.last_time = header->last_time;
+                std::copy(totals, totals + width, snap_totals.values.begin());
+                // totals the producer may have changed while copying are copied again
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (header->totals_seq.load(std::memory_order_relaxed) == seq) return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    SampleBuffer *profiling_util::GeneralSampler::_add_buffer(const metric_info &metric)
+    {
+        buffer_names.push_back(metric.name);
+        buffer_units.push_back(metric.unit);
+        buffers.emplace_back(std::make_unique<SampleBuffer>(metric.width));
+        return buffers.back().get();
+    }
+
+    void profiling_util::GeneralSampler::_store_sample(SampleBuffer *buffer, double time, const double *vals, std::ofstream &out, const std::string &fname)
+    {
+        buffer->push(time, vals);
+        if (!keep_files) return;
+        if (!out.is_open()) out.open(fname, std::ios::app);
+        for (size_t i=0;i<buffer->GetWidth();i++) out << vals[i] << "\n";
+        out.flush();
+    }
+
+    SamplerScheduler &SamplerScheduler::Get()
+    {
+        static SamplerScheduler scheduler;
+        return scheduler;
+    }
+
+    SamplerScheduler::~SamplerScheduler()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            stopFlag = true;
+        }
+        cv.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+
+    void SamplerScheduler::_run()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stopFlag)
+        {
+            if (deadlines.empty()) 
+            {
+                cv.wait(lock);
+                continue;
+            }
+            auto [deadline, id] = deadlines.top();
+            auto it = tasks.find(id);
+            // entries of removed or rescheduled tasks are stale
+            if (it == tasks.end() || it->second.removed || it->second.deadline != deadline) 
+            {
+                deadlines.pop();
+                continue;
+            }
+            if (clock::now() < deadline) 
+            {
+                cv.wait_until(lock, deadline);
+                continue;
+            }
+            deadlines.pop();
+            // the stored function is run, keeping any state it has between samples. Remove
+            // waits for it to finish before erasing it
+            running_id = id;
+            auto &func = it->second.func;
+            lock.unlock();
+            func();
+            lock.lock();
+            running_id = -1;
+            done_cv.notify_all();
+            if (it->second.removed) 
+            {
+                tasks.erase(it);
+                continue;
+            }
+            // next deadline, skipping missed deadlines rather than sampling in a burst
+            auto &task = it->second;
+            task.deadline += task.period;
+            auto now = clock::now();
+            if (task.deadline < now && task.period.count() > 0) task.deadline += ((now - task.deadline) / task.period + 1) * task.period;
+            deadlines.emplace(task.deadline, id);
+        }
+    }
+
+    int SamplerScheduler::Add(std::function<void()> func, clock::duration period)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!thread.joinable()) 
+        {
+            thread = std::thread(&SamplerScheduler::_run, this);
+            if (core >= 0) _set_affinity();
+        }
+        int id = next_id++;
+        auto deadline = clock::now();
+        tasks[id] = task_entry{func, period, deadline};
+        deadlines.emplace(deadline, id);
+        cv.notify_all();
+        return id;
+    }
+
+    void SamplerScheduler::Remove(int id)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto it = tasks.find(id);
+        if (it == tasks.end()) return;
+        it->second.removed = true;
+        // a task removing itself cannot wait for itself to finish, it is erased once it returns
+        if (running_id == id && std::this_thread::get_id() == thread.get_id()) return;
+        done_cv.wait(lock, [this, id]{return running_id != id;});
+        tasks.erase(id);
+    }
+
+    int SamplerScheduler::GetNumTasks()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return tasks.size();
+    }
+
+    void SamplerScheduler::_set_affinity()
+    {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(core, &mask);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(mask), &mask);
+    }
+
+    bool SamplerScheduler::SetCore(int _core)
+    {
+        cpu_set_t mask;
+        if (sched_getaffinity(0, sizeof(mask), &mask) != 0) return false;
+        std::vector<int> cores;
+        for (int i = 0; i < CPU_SETSIZE; i++) if (CPU_ISSET(i, &mask)) cores.push_back(i);
+        if (_core < 0) 
+        {
+            if (static_cast<int>(cores.size()) < -_core) return false;
+            _core = cores[cores.size() + _core];
+        }
+        else if (std::find(cores.begin(), cores.end(), _core) == cores.end()) return false;
+        std::unique_lock<std::mutex> lock(mtx);
+        core = _core;
+        if (thread.joinable()) _set_affinity();
+        return true;
+    }
+
+    bool SetSamplerCore(int core)
+    {
+        return SamplerScheduler::Get().SetCore(core);
+    }
+
+    static std::string &_gpu_monitor_cmd()
+    {
+        static std::string cmd = [](){
+            auto env = std::getenv("PU_GPU_MONITOR_CMD");
+            if (env != nullptr && env[0] != '\0') return std::string(env);
+#ifdef _GPU
+            return std::string(pu_gpuMonitorCmd);
+#else 
+            return std::string("nvidia-smi");
+#endif
+        }();
+        return cmd;
+    }
+
+    void SetGPUMonitorCmd(const std::string &cmd)
+    {
+        _gpu_monitor_cmd() = cmd;
+    }
+
+    std::string GetGPUMonitorCmd()
+    {
+        return _gpu_monitor_cmd();
+    }
+
+    void profiling_util::GeneralSampler::_sample_source(std::shared_ptr<source_state> state)
+    {
+        auto time = _get_sample_time();
+        auto &metrics = state->source->GetMetrics();
+        state->source->Sample(time, [this, &state, &metrics](size_t metric, double t, const double *vals) {
+            _store_sample(state->buffers[metric], t, vals, state->outs[metric], metrics[metric].name);
+        });
+    }
+
+    void profiling_util::GeneralSampler::_add_source(std::shared_ptr<MetricSource> source, std::vector<SampleBuffer *> source_buffers)
+    {
+        auto state = std::make_shared<source_state>();
+        state->source = source;
+        state->buffers = std::move(source_buffers);
+        state->outs.resize(state->buffers.size());
+        sources.push_back(state);
+        // open before scheduling so the task does not sample the source while it is opened
+        if (!stopFlag) source->Open();
+        _add_task(std::bind(&profiling_util::GeneralSampler::_sample_source, this, state));
+    }
+
+    void profiling_util::GeneralSampler::AddSource(std::shared_ptr<MetricSource> source)
+    {
+        std::vector<SampleBuffer *> source_buffers;
+        for (auto &metric : source->GetMetrics()) source_buffers.push_back(_add_buffer(metric));
+        _add_source(source, source_buffers);
+    }
+
+    void profiling_util::GeneralSampler::AddMonitorStream(const std::string &cmd, const std::vector<std::string> &fnames, int nrows)
+    {
+        std::vector<metric_info> metrics;
+        for (auto &fname : fnames) metrics.push_back({fname, "", nrows});
+        AddSource(std::make_shared<MonitorStreamSource>(cmd, metrics, sample_time / 1e6));
+    }
+
+    std::string profiling_util::GeneralSampler::GetMetricUnit(const std::string &name)
+    {
+        for (size_t i=0;i<buffer_names.size();i++) if (buffer_names[i] == name) return buffer_units[i];
+        return "";
+    }
+
+#ifdef _MPI
+    void profiling_util::GeneralSampler::_set_node_comm(MPI_Comm &comm)
+    {
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+        MPI_Comm_rank(node_comm, &node_rank);
+    }
+#endif
+
+    std::vector<SampleBuffer *> profiling_util::GeneralSampler::_add_node_buffers(const std::vector<metric_info> &metrics)
+    {
+        std::vector<SampleBuffer *> node_buffers;
+#ifdef _MPI
+        if (node_comm != MPI_COMM_NULL) 
+        {
+            // the leader's widths are used by all so the shared buffers have the same layout
+            int nmetrics = metrics.size();
+            MPI_Bcast(&nmetrics, 1, MPI_INT, 0, node_comm);
+            std::vector<int> widths(nmetrics, 1);
+            for (size_t i=0;i<metrics.size() && i<widths.size();i++) widths[i] = metrics[i].width;
+            MPI_Bcast(widths.data(), nmetrics, MPI_INT, 0, node_comm);
+            auto capacity = SampleBuffer::default_capacity;
+            MPI_Aint bytes = 0;
+            for (auto &w : widths) bytes += SampleBuffer::GetRequiredBytes(w, capacity);
+            char *base = nullptr;
+            MPI_Win_allocate_shared((node_rank == 0) ? bytes : 0, 1, MPI_INFO_NULL, node_comm, &base, &node_win);
+            if (node_rank != 0) 
+            {
+                MPI_Aint size;
+                int disp_unit;
+                MPI_Win_shared_query(node_win, 0, &size, &disp_unit, &base);
+            }
+            // buffers must be initialised by the leader before the others attach to them
+            if (node_rank != 0) MPI_Barrier(node_comm);
+            for (int i=0;i<nmetrics;i++) 
+            {
+                buffer_names.push_back(metrics[i].name);
+                buffer_units.push_back(metrics[i].unit);
+                buffers.emplace_back(std::make_unique<SampleBuffer>(base, widths[i], capacity, node_rank == 0));
+                node_buffers.push_back(buffers.back().get());
+                base += SampleBuffer::GetRequiredBytes(widths[i], capacity);
+            }
+            if (node_rank == 0) MPI_Barrier(node_comm);
+            return node_buffers;
+        }
+#endif
+        for (auto &metric : metrics) node_buffers.push_back(_add_buffer(metric));
+        return node_buffers;
+    }
+
+    void profiling_util::GeneralSampler::_add_node_sources(const std::vector<std::shared_ptr<MetricSource>> &node_sources)
+    {
+        std::vector<metric_info> metrics;
+        for (auto &source : node_sources) 
+        {
+            metrics.insert(metrics.end(), source->GetMetrics().begin(), source->GetMetrics().end());
+        }
+        auto node_buffers = _add_node_buffers(metrics);
+        if (!GetIsNodeSampler()) return;
+        auto first = node_buffers.begin();
+        for (auto &source : node_sources) 
+        {
+            auto last = first + source->GetMetrics().size();
+            _add_source(source, std::vector<SampleBuffer *>(first, last));
+            first = last;
+        }
+    }
+
+#ifdef _MPI
+    void profiling_util::GeneralSampler::AddNodeSources(MPI_Comm &comm, const std::vector<std::shared_ptr<MetricSource>> &node_sources)
+    {
+        _set_node_comm(comm);
+        _add_node_sources(node_sources);
+    }
+#endif
+
+    void profiling_util::GeneralSampler::_launch_to_file(std::vector<std::string> requests, std::vector<std::string> fnames)
+    {
+        long_lived_cmds.insert(long_lived_cmds.end(), requests.begin(), requests.end());
+        long_lived_fnames.insert(long_lived_fnames.end(), fnames.begin(), fnames.end());
+        if (!stopFlag) _spawn_long_lived();
+    }
+
+    void profiling_util::GeneralSampler::_spawn_long_lived()
+    {
+        for (size_t i=long_lived_pids.size();i<long_lived_cmds.size();i++) 
+        {
+            long_lived_pids.push_back(spawn_cmd_to_file(long_lived_cmds[i], long_lived_fnames[i]));
+        }
+        for (auto &state : sources) state->source->Open();
+    }
+
+    void profiling_util::GeneralSampler::_stop_long_lived()
     {
-        if (requests.size() == 0) return;
-        std::string s;
-        std::string cmd;
-        for (size_t i=0;i<requests.size();i++) 
+        for (auto &child : long_lived_pids) 
         {
-            auto req = requests[i];
-            auto fname = fnames[i];
-            s = req;
-            cmd = _set_sampling(s, fname);
-            (*threads).emplace_back(std::thread(&profiling_util::GeneralSampler::_place_long_lived_cmd, this, cmd, sample_time));
+            if (child < 0) continue;
+            kill(child, SIGTERM);
+            wait_cmd(child);
         }
+        long_lived_pids.clear();
+        for (auto &state : sources) state->source->Close();
     }
+
     profiling_util::GeneralSampler::GeneralSampler(const std::string &f, const std::string &F, const std::string &l, float _sample_time_in_sec, bool _use_device, bool _keep_files) : profiling_util::Timer::Timer(f,F,l,_use_device)
     {
         pid = getpid();
@@ -34,35 +500,74 @@ namespace profiling_util {
         std::srand(static_cast<unsigned>(std::time(nullptr)));
         id = std::rand();
         sample_time = _sample_time_in_sec*1000000.0;//convert to micro seconds
+        sample_t0 = std::chrono::steady_clock::now();
         use_device = _use_device;
         keep_files = _keep_files;
-        // allocate the thread vector
-        threads = new std::vector<std::thread>;
     }
     profiling_util::GeneralSampler::~GeneralSampler()
     {
         Pause();
-        delete threads;
+#ifdef _MPI
+        if (node_win != MPI_WIN_NULL) 
+        {
+            // leader must have stopped writing to the window before others detach
+            MPI_Barrier(node_comm);
+            buffers.clear();
+            MPI_Win_free(&node_win);
+            MPI_Comm_free(&node_comm);
+        }
+#endif
+    }
+    void profiling_util::GeneralSampler::_add_task(std::function<void()> task)
+    {
+        tasks.push_back(task);
+        auto period = std::chrono::duration_cast<SamplerScheduler::clock::duration>(std::chrono::duration<double, std::micro>(sample_time));
+        if (!stopFlag) task_ids.push_back(SamplerScheduler::Get().Add(task, period));
     }
     void profiling_util::GeneralSampler::Pause()
     {
-        std::unique_lock<std::mutex> lock(mtx);
         stopFlag = true;
-        cv.notify_all();
-        for (auto &t: *threads) t.join();
-        (*threads).clear();
+        for (auto &task_id: task_ids) SamplerScheduler::Get().Remove(task_id);
+        task_ids.clear();
+        _stop_long_lived();
     }
     void profiling_util::GeneralSampler::Restart()
     {
+        if (!stopFlag) return;
         stopFlag = false;
-        cv.notify_all();
-        _launch();
+        auto period = std::chrono::duration_cast<SamplerScheduler::clock::duration>(std::chrono::duration<double, std::micro>(sample_time));
+        // open the sources before scheduling so their tasks do not sample them while they are opened
+        _spawn_long_lived();
+        for (auto &task: tasks) task_ids.push_back(SamplerScheduler::Get().Add(task, period));
+    }
+
+    bool profiling_util::GeneralSampler::GetTotals(const std::string &fname, sample_totals &totals)
+    {
+        for (size_t i=0;i<buffer_names.size();i++)
+        {
+            if (buffer_names[i] != fname) continue;
+            buffers[i]->GetTotals(totals);
+            return true;
+        }
+        return false;
+    }
+
+    bool profiling_util::GeneralSampler::GetSamples(const std::string &fname, std::vector<double> &times, std::vector<double> &values)
+    {
+        for (size_t i=0;i<buffer_names.size();i++)
+        {
+            if (buffer_names[i] != fname) continue;
+            buffers[i]->Snapshot(times, values);
+            return true;
+        }
+        return false;
     }
 
     std::vector<double> profiling_util::GeneralSampler::GetSamplingData(const std::string &fname)
     {
+        std::vector<double> times, content;
+        if (GetSamples(fname, times, content)) return content;
         std::ifstream file(fname);
-        std::vector<double> content;
         std::string line;
         while (std::getline(file, line)) {
             double val;
@@ -81,6 +586,17 @@ namespace profiling_util {
     }
 
     profiling_util::ComputeSampler::ComputeSampler(const std::string &f, const std::string &F, const std::string &l, float _sample_time_in_sec, bool _use_device, bool _keep_files) : profiling_util::GeneralSampler(f, F, l, _sample_time_in_sec, _use_device, _keep_files)
+    {
+        _setup();
+    }
+#ifdef _MPI
+    profiling_util::ComputeSampler::ComputeSampler(const std::string &f, const std::string &F, const std::string &l, MPI_Comm &comm, float _sample_time_in_sec, bool _use_device, bool _keep_files) : profiling_util::GeneralSampler(f, F, l, _sample_time_in_sec, _use_device, _keep_files)
+    {
+        _set_node_comm(comm);
+        _setup();
+    }
+#endif
+    void profiling_util::ComputeSampler::_setup()
     {
         cpu_usage_fname = ".sampler.cpu_usage." + std::to_string(id) + ".txt";
 #ifdef _GPU
@@ -89,15 +605,31 @@ namespace profiling_util {
         gpu_mem_fname = ".sampler.gpu_mem."+std::to_string(id)+".txt";
         gpu_memusage_fname = ".sampler.gpu_memusage."+std::to_string(id)+".txt";
         pu_gpuErrorCheck(pu_gpuGetDeviceCount(&nDevices));
+#ifdef _MPI
+        if (node_comm != MPI_COMM_NULL) MPI_Bcast(&nDevices, 1, MPI_INT, 0, node_comm);
+#endif
 #endif
 #ifdef _CRAY_ENERGY_COUNTERS
         cray_node_energy_fname = ".sampler.cray_node_energy."+std::to_string(id)+".txt";
 #endif
-        std::string s_cpu = " ps -p " + std::to_string(pid) + " -o %cpu | tail -n 1";
-        std::vector<std::string> requests = {s_cpu};
-        std::vector<std::string> fnames = {cpu_usage_fname};
+        // cpu usage is sampled in process from the cpu time clock of the process
+        AddSource(std::make_shared<CPUUsageSource>(cpu_usage_fname));
+        // node level metrics
+        std::vector<std::shared_ptr<MetricSource>> node_sources;
 #ifdef _GPU
         if (use_device) {
+            std::vector<metric_info> gpu_metrics = {
+                {gpu_usage_fname, "%", nDevices},
+                {gpu_energy_fname, "W", nDevices},
+                {gpu_mem_fname, "MiB", nDevices},
+                {gpu_memusage_fname, "%", nDevices}
+            };
+#ifdef pu_gpu_stream_request
+            // a single long lived monitor prints all metrics every sample period
+            int loop_ms = std::max(1, static_cast<int>(sample_time / 1000.0));
+            node_sources.push_back(std::make_shared<MonitorStreamSource>(GetGPUMonitorCmd() + pu_gpu_stream_request(loop_ms), gpu_metrics, sample_time / 1e6));
+#else 
+            // the monitor cannot stream so it is run per sample
             std::vector<std::string> s_gpu_requests = {
                 std::string(pu_gpu_usage_request(nDevices)),
                 std::string(pu_gpu_energy_request(nDevices)),
@@ -106,25 +638,22 @@ namespace profiling_util {
             };
             for (size_t i=0;i<s_gpu_requests.size();i++) 
             {
-                auto req = s_gpu_requests[i];
-                auto s_gpu = std::string(pu_gpuMonitorCmd) + " " + req + " " + std::string(pu_gpu_formating(nDevices));
-                requests.push_back(s_gpu);
+                auto s_gpu = GetGPUMonitorCmd() + " " + s_gpu_requests[i] + " " + std::string(pu_gpu_formating(nDevices));
+                node_sources.push_back(std::make_shared<CommandSource>(gpu_metrics[i].name, gpu_metrics[i].unit, s_gpu, nDevices));
             }
-            fnames.push_back(gpu_usage_fname);
-            fnames.push_back(gpu_energy_fname);
-            fnames.push_back(gpu_mem_fname);
-            fnames.push_back(gpu_memusage_fname);
+#endif
         }
 #endif
 #ifdef _CRAY_ENERGY_COUNTERS
-        std::string s_cray_node_energy = "cat /sys/cray/pm_counters/energy | awk '{print $1}'";
-        requests.push_back(s_cray_node_energy);
-        fnames.push_back(cray_node_energy_fname);
+        // the counter is read directly rather than running cat and awk every sample
+        node_sources.push_back(std::make_shared<FileSource>(cray_node_energy_fname, "J", "/sys/cray/pm_counters/energy"));
 #endif
-        profiling_util::ComputeSampler::_launch(requests,fnames);
+        _add_node_sources(node_sources);
     }
     profiling_util::ComputeSampler::~ComputeSampler()
     {
+        // stop sampling before the members the sampling tasks use are destroyed
+        Pause();
         // and remove files
         if (keep_files) return;
         std::filesystem::remove(cpu_usage_fname);
@@ -167,15 +696,161 @@ namespace profiling_util {
         return report.str();
     }
 
+    std::string ReportMetric(profiling_util::GeneralSampler &s, 
+        const std::string &name,
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num)
+    {
+        sample_totals totals;
+        std::ostringstream report;
+        report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
+        if (!s.GetTotals(name, totals)) 
+        {
+            report << name << " not sampled";
+            return report.str();
+        }
+        auto unit = s.GetMetricUnit(name);
+        size_t n = totals.values.size();
+        if (n <= 1)
+        {
+            auto [ave, std, min, max, nsample] = get_stats(totals);
+            report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "Metric", name, unit, ave, std, min, max, nsample);
+            return report.str();
+        }
+        for (size_t i=0;i<n;i++) 
+        {
+            auto [ave, std, min, max, nsample] = get_stats(totals, i);
+            report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "Metric", name+"["+std::to_string(i)+"]", unit, ave, std, min, max, nsample);
+            report <<" | ";
+        }
+        return report.str();
+    }
+
+    std::string ReportIOStats(profiling_util::IOSampler &s, 
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num)
+    {
+        std::ostringstream report;
+        report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
+        auto start = s.GetStartCounters();
+        auto current = get_io_counters();
+        if (!start.valid || !current.valid) 
+        {
+            report << "IO counters of /proc/self/io not available";
+            return report.str();
+        }
+        std::vector<std::tuple<std::string, std::string, std::string>> metrics = {
+            {s.GetIOReadFname(), "Read", "MiB/s"},
+            {s.GetIOWriteFname(), "Write", "MiB/s"},
+            {s.GetIOStatsFname(), "Calls", "1/s"},
+        };
+        for (auto &[fname, prop, unit] : metrics) 
+        {
+            sample_totals totals;
+            s.GetTotals(fname, totals);
+            std::vector<std::string> devs = {"IO", "IO Storage"};
+            if (prop == "Calls") devs = {"IO Read", "IO Write"};
+            for (auto i=0;i<2;i++) 
+            {
+                auto [ave, std, min, max, nsample] = get_stats(totals, i);
+                report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), devs[i], prop, unit, ave, std, min, max, nsample);
+                report <<" | ";
+            }
+        }
+        // totals since creation from the counters, exact rather than integrated from the samples
+        const double mib = 1.0 / (1024.0 * 1024.0);
+        auto read = current.rchar - start.rchar, read_storage = current.read_bytes - start.read_bytes;
+        auto written = current.wchar - start.wchar, written_storage = current.write_bytes - start.write_bytes;
+        report << "IO totals : read (MiB) = " << read * mib << " of which from storage = " << read_storage * mib;
+        if (read > 0) report << " (" << std::max(0.0, 100.0 * (1.0 - static_cast<double>(read_storage) / read)) << "% from page cache)";
+        report << ", written (MiB) = " << written * mib << " of which to storage = " << written_storage * mib;
+        report << ", read calls = " << current.syscr - start.syscr << ", write calls = " << current.syscw - start.syscw;
+        return report.str();
+    }
+
+    std::string ReportMemoryPeaks(profiling_util::MemorySampler &s, 
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num)
+    {
+        std::ostringstream report;
+        report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
+        std::vector<double> times, content, region_times, region_content;
+        s.GetSamples(s.GetMemFname(), times, content);
+        s.GetSamples(s.GetMemRegionFname(), region_times, region_content);
+        auto regions = s.GetRegions();
+        const size_t n = 5;
+        if (times.size() == 0) 
+        {
+            report << "No memory samples";
+            return report.str();
+        }
+        // the region of each sample, the region snapshot being taken separately may hold 
+        // other samples at either end
+        std::vector<std::string> sample_regions(times.size(), regions[0]);
+        for (size_t i=0, j=0;i<times.size();i++) 
+        {
+            while (j < region_times.size() && region_times[j] < times[i]) j++;
+            if (j == region_times.size()) break;
+            auto r = static_cast<size_t>(region_content[j]);
+            if (region_times[j] == times[i] && r < regions.size()) sample_regions[i] = regions[r];
+        }
+        // statistics are over all samples, the peaks and growth over those retained
+        sample_totals totals;
+        s.GetTotals(s.GetMemFname(), totals);
+        if (times.front() > totals.first_time) 
+        {
+            report <<"Peaks and growth located in the last "<<times.size()<<" of "<<totals.count<<" samples, from "<<times.front()<<" s | ";
+        }
+        std::vector<std::string> kinds = {"RSS", "VM", "Anon", "File", "Shmem"};
+        for (size_t k=0;k<n;k++) 
+        {
+            auto [ave, std, min, max, nsample] = get_stats(totals, k);
+            size_t ipeak = 0;
+            for (size_t i=0;i<times.size();i++) if (content[i*n+k] > content[ipeak*n+k]) ipeak = i;
+            report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "Memory", kinds[k], "MiB", ave, std, min, max, nsample);
+            report <<"peak at "<<times[ipeak]<<" s in "<<sample_regions[ipeak];
+            report <<" | ";
+        }
+        // growth of the RSS over the whole sampling and the fastest growth between samples 
+        if (times.size() > 1) 
+        {
+            double growth = (content[(times.size()-1)*n] - content[0]) / (times.back() - times.front());
+            double max_growth = 0;
+            size_t imax = 0;
+            for (size_t i=1;i<times.size();i++) 
+            {
+                double dt = times[i] - times[i-1];
+                if (dt <= 0) continue;
+                double rate = (content[i*n] - content[(i-1)*n]) / dt;
+                if (rate > max_growth) {max_growth = rate; imax = i;}
+            }
+            report <<"RSS growth (MiB/s) : average = "<<growth<<", maximum = "<<max_growth;
+            if (max_growth > 0) report <<" at "<<times[imax]<<" s in "<<sample_regions[imax];
+            report <<" | ";
+        }
+        // peak RSS of each region sampled
+        std::map<std::string, double> region_peaks;
+        for (size_t i=0;i<times.size();i++) 
+        {
+            auto &peak = region_peaks[sample_regions[i]];
+            peak = std::max(peak, content[i*n]);
+        }
+        report <<"Region peak RSS (MiB) :";
+        for (auto &[ref, peak] : region_peaks) report <<" "<<ref<<" = "<<peak<<";";
+        return report.str();
+    }
+
     std::string ReportCPUUsage(profiling_util::ComputeSampler &s, 
         const std::string &function, 
         const std::string &file, 
         const std::string &line_num)
     {
-        s.Pause();
-        std::vector<double> content(s.GetSamplingData(s.GetCPUUsageFname()));
-        s.Restart();
-        auto [ave, std, min, max, nsample] = get_stats(content);
+        sample_totals totals;
+        s.GetTotals(s.GetCPUUsageFname(), totals);
+        auto [ave, std, min, max, nsample] = get_stats(totals);
         return _make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "CPU", "Usage", "%", ave, std, min, max, nsample, true);
     }
 #ifdef _GPU
@@ -185,15 +860,14 @@ namespace profiling_util {
         const std::string &line_num, 
         int gid)
     {
-        s.Pause();
-        std::vector<double> content(std::move(s.GetSamplingData(s.GetGPUEnergyFname())));
-        s.Restart();
+        sample_totals totals;
+        s.GetTotals(s.GetGPUUsageFname(), totals);
         auto n = s.GetNumDevices();
         std::ostringstream report;
         report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
         for (auto i=0;i<n;i++) 
         {
-            auto [ave, std, min, max, nsample] = get_stats(content, i, n);
+            auto [ave, std, min, max, nsample] = get_stats(totals, i);
             report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "GPU"+std::to_string(i), "Usage", "%", ave, std, min, max, nsample);
             report <<" | ";
         }
@@ -205,17 +879,16 @@ namespace profiling_util {
         const std::string &line_num,
         int gid)
     {
-        s.Pause();
-        std::vector<double> content(std::move(s.GetSamplingData(s.GetGPUEnergyFname())));
-        s.Restart();
+        sample_totals totals;
+        s.GetTotals(s.GetGPUEnergyFname(), totals);
         auto n = s.GetNumDevices();
         std::ostringstream report;
         report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
         for (auto i=0;i<n;i++) 
         {
-            auto [ave, std, min, max, nsample] = get_stats(content, i, n);
-            // to get Wh
-            auto energy_used = ave * static_cast<double>(content.size()) * s.GetSampleTime()/1000.0/3600.0;
+            auto [ave, std, min, max, nsample] = get_stats(totals, i);
+            // power integrated over the sample times as sampled, converted from J to Wh
+            auto energy_used = (i < static_cast<int>(totals.values.size())) ? totals.values[i].integral/3600.0 : 0.0;
             report << _make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "GPU"+std::to_string(i), "Power", "W", ave, std, min, max, nsample);
             report <<" GPU Energy (Wh) used = "<< energy_used;
             report <<" | ";
@@ -228,15 +901,14 @@ namespace profiling_util {
         const std::string &line_num, 
         int gid)
     {
-        s.Pause();
-        std::vector<double> content(std::move(s.GetSamplingData(s.GetGPUEnergyFname())));
-        s.Restart();
+        sample_totals totals;
+        s.GetTotals(s.GetGPUMemFname(), totals);
         auto n = s.GetNumDevices();
         std::ostringstream report;
         report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
         for (auto i=0;i<n;i++) 
         {
-            auto [ave, std, min, max, nsample] = get_stats(content, i, n);
+            auto [ave, std, min, max, nsample] = get_stats(totals, i);
             report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "GPU"+std::to_string(i), "Memory", "MiB", ave, std, min, max, nsample);
             report <<" | ";
         }
@@ -248,15 +920,14 @@ namespace profiling_util {
         const std::string &line_num, 
         int gid)
     {
-        s.Pause();
-        std::vector<double> content(std::move(s.GetSamplingData(s.GetGPUEnergyFname())));
-        s.Restart();
+        sample_totals totals;
+        s.GetTotals(s.GetGPUMemUsageFname(), totals);
         auto n = s.GetNumDevices();
         std::ostringstream report;
         report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
         for (auto i=0;i<n;i++) 
         {
-            auto [ave, std, min, max, nsample] = get_stats(content, i, n);
+            auto [ave, std, min, max, nsample] = get_stats(totals, i);
             report <<_make_statistics_report<double>(function, file, line_num, s.get_ref(), ns_time(s.get()), "GPU"+std::to_string(i), "Memory Usage", "%", ave, std, min, max, nsample);
             report <<" | ";
         }
@@ -268,7 +939,6 @@ namespace profiling_util {
         const std::string &line_num, 
         int gid)
     {
-        s.Pause();
         auto t = ns_time(s.get());
         auto ref = s.get_ref();
         auto n = s.GetNumDevices();
@@ -280,19 +950,19 @@ namespace profiling_util {
         report << "GPU Statistics || ";
         for (size_t i=0;i<flist.size();i++) 
         {
-            std::vector<double> content(std::move(s.GetSamplingData(flist[i])));
+            sample_totals totals;
+            s.GetTotals(flist[i], totals);
             for (auto j=0;j<n;j++) {
-                auto [ave, std, min, max, nsample] = get_stats(content, j, n);
+                auto [ave, std, min, max, nsample] = get_stats(totals, j);
                 report<< _make_statistics_report<double>(function, file, line_num, ref, t, "GPU"+std::to_string(j), plist[i], ulist[i], ave, std, min, max, nsample);
                 if (plist[i] == "Power") 
                 {
-                    auto energy_used = ave * static_cast<double>(content.size()) * s.GetSampleTime()/1000.0/3600.0;
+                    auto energy_used = (j < static_cast<int>(totals.values.size())) ? totals.values[j].integral/3600.0 : 0.0;
                     report <<" GPU Energy (Wh) used = "<< energy_used;
                 }
                 report <<" || ";
             }
         }
-        s.Restart();
         return report.str();
     }
 #endif
@@ -303,28 +973,100 @@ namespace profiling_util {
         const std::string &file, 
         const std::string &line_num)
     {
-        s.Pause();
-        std::vector<double> content(std::move(s.GetSamplingData(s.GetCrayNodeEnergyFname())));
-        s.Restart();
+        sample_totals totals;
+        s.GetTotals(s.GetCrayNodeEnergyFname(), totals);
         std::ostringstream report;
         report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
-        float diff = content[content.size()-1] - content[0];
+        // the counter is cumulative, the energy is the change since the first sample
+        float diff = (totals.count > 0) ? totals.values[0].last - totals.values[0].first : 0;
         // to get node energy
         report <<"Node Energy (J) used = " << diff;
         return report.str();
     }
 #endif
 
+    std::string ReportSamplerTiming(profiling_util::GeneralSampler &s, 
+        const std::string &function, 
+        const std::string &file, 
+        const std::string &line_num)
+    {
+        std::ostringstream report;
+        report <<_make_statistics_report_header(function, file, line_num, s.get_ref(), ns_time(s.get()));
+        double period = s.GetSampleTime()/1e6;
+        report << "Sampling requested rate (Hz) = " << 1.0/period << " | ";
+        for (auto &name : s.GetMetricNames())
+        {
+            std::vector<double> times, values;
+            s.GetSamples(name, times, values);
+            auto [rate, ave, std, maxdev, nsample] = get_sampling_stats(times, period);
+            report << name << " achieved rate (Hz) = " << rate;
+            report << " interval (s) [ave,std,max deviation,n] = [ " << ave << ", " << std << ", " << maxdev << ", " << nsample << " ] | ";
+        }
+        return report.str();
+    }
+
+    profiling_util::IOSampler::IOSampler(const std::string &f, const std::string &F, const std::string &l, float _sample_time_in_sec, bool _keep_files) : profiling_util::GeneralSampler(f, F, l, _sample_time_in_sec, false, _keep_files)
+    {
+        io_ops_fname = ".sampler.io_ops." + std::to_string(id) + ".txt";
+        io_read_fname = ".sampler.io_read." + std::to_string(id) + ".txt";
+        io_write_fname = ".sampler.io_write." + std::to_string(id) + ".txt";
+        start = get_io_counters();
+        AddSource(std::make_shared<ProcIOSource>(io_ops_fname, io_read_fname, io_write_fname));
+    }
+    profiling_util::IOSampler::~IOSampler()
+    {
+        // stop sampling before the members the sampling tasks use are destroyed
+        Pause();
+        // and remove files
+        if (keep_files) return;
+        std::filesystem::remove(io_ops_fname);
+        std::filesystem::remove(io_read_fname);
+        std::filesystem::remove(io_write_fname);
+    }
+
+    profiling_util::MemorySampler::MemorySampler(const std::string &f, const std::string &F, const std::string &l, float _sample_time_in_sec, bool _keep_files) : profiling_util::GeneralSampler(f, F, l, _sample_time_in_sec, false, _keep_files)
+    {
+        mem_fname = ".sampler.memory." + std::to_string(id) + ".txt";
+        mem_region_fname = ".sampler.memory_region." + std::to_string(id) + ".txt";
+        regions.push_back(get_ref());
+        region = std::make_shared<std::atomic<int>>(0);
+        AddSource(std::make_shared<ProcMemorySource>(mem_fname, mem_region_fname, region));
+    }
+    profiling_util::MemorySampler::~MemorySampler()
+    {
+        // stop sampling before the members the sampling tasks use are destroyed
+        Pause();
+        // and remove files
+        if (keep_files) return;
+        std::filesystem::remove(mem_fname);
+        std::filesystem::remove(mem_region_fname);
+    }
+    void profiling_util::MemorySampler::SetActiveTimer(const Timer &t)
+    {
+        auto ref = t.get_ref();
+        std::lock_guard<std::mutex> lock(regions_mtx);
+        auto it = std::find(regions.begin(), regions.end(), ref);
+        if (it == regions.end()) it = regions.insert(it, ref);
+        *region = static_cast<int>(it - regions.begin());
+    }
+    std::vector<std::string> profiling_util::MemorySampler::GetRegions()
+    {
+        std::lock_guard<std::mutex> lock(regions_mtx);
+        return regions;
+    }
+
     profiling_util::STraceSampler::STraceSampler(const std::string &f, const std::string &F, const std::string &l, float _sample_time_in_sec, bool _use_device, bool _keep_files) : profiling_util::GeneralSampler(f, F, l, _sample_time_in_sec, _use_device, _keep_files)
     {
         strace_fname = ".sampler.strace." + std::to_string(id) + ".txt";
-        std::string s_cpu = "strace -d -p " + std::to_string(pid) + " 2>&1 ";
+        std::string s_cpu = "strace -d -p " + std::to_string(pid);
         std::vector<std::string> requests = {s_cpu};
         std::vector<std::string> fnames = {strace_fname};
-        profiling_util::STraceSampler::_launch(requests,fnames);
+        profiling_util::STraceSampler::_launch_to_file(requests,fnames);
     }
     profiling_util::STraceSampler::~STraceSampler()
     {
+        // stop sampling before the members the sampling tasks use are destroyed
+        Pause();
         // and remove files
         if (keep_files) return;
         std::filesystem::remove(strace_fname);
@@ -351,6 +1093,102 @@ namespace profiling_util {
         return static_cast<float>((t.get()));
     }
 
+    std::string ReportTimeTaken(Timer &t, const source_location &where)
+    {
+        std::ostringstream report;
+        report <<"Time taken between : " << where << " - " << t.get_ref() << " : " << ns_time(t.get());
+        return report.str();
+    }
+
+    float GetTimeTaken(Timer &t, const source_location &)
+    {
+        return static_cast<float>((t.get()));
+    }
+
+    // the least number of bits of sub-buckets that splits each power of two finer than the
+    // digits asked for, as in HdrHistogram
+    lap_histogram::lap_histogram(int significant_digits)
+    {
+        digits = std::max(1, std::min(4, significant_digits));
+        bits = static_cast<int>(std::ceil(std::log2(2 * std::pow(10.0, digits))));
+        counts.assign((std::size_t(1) << bits) + (std::size_t(64 - bits) << (bits - 1)), 0);
+    }
+
+    std::pair<uint64_t, uint64_t> lap_histogram::_bounds(std::size_t index) const
+    {
+        auto nexact = std::size_t(1) << bits, half = std::size_t(1) << (bits - 1);
+        if (index < nexact) return {index, index};
+        auto k = index - nexact;
+        int shift = static_cast<int>(k / half) + 1;
+        uint64_t lower = static_cast<uint64_t>(half + k % half) << shift;
+        return {lower, lower + ((uint64_t(1) << shift) - 1)};
+    }
+
+    void lap_histogram::merge(const lap_histogram &other)
+    {
+        if (other.count == 0) return;
+        if (other.bits == bits) 
+        {
+            for (std::size_t i=0;i<counts.size();i++) counts[i] += other.counts[i];
+        }
+        else 
+        {
+            for (std::size_t i=0;i<other.counts.size();i++)
+            {
+                if (other.counts[i] == 0) continue;
+                auto bounds = other._bounds(i);
+                counts[_index(bounds.first + (bounds.second - bounds.first) / 2)] += other.counts[i];
+            }
+        }
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    void lap_histogram::reset()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        count = sum = max = 0;
+        min = std::numeric_limits<uint64_t>::max();
+    }
+
+    uint64_t lap_histogram::get_percentile(double percentile) const
+    {
+        if (count == 0) return 0;
+        percentile = std::max(0.0, std::min(100.0, percentile));
+        auto target = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count + 0.5));
+        uint64_t cumulative = 0;
+        for (std::size_t i=0;i<counts.size();i++)
+        {
+            cumulative += counts[i];
+            if (cumulative >= target) return std::min(_bounds(i).second, max);
+        }
+        return max;
+    }
+
+    std::string ReportLaps(const lap_histogram &laps, const std::string &name, const source_location &where)
+    {
+        std::ostringstream report;
+        report << "Laps at : " << where << " - " << name << " : count = " << laps.get_count();
+        if (laps.get_count() > 0)
+        {
+            report << ", mean = " << ns_time(static_cast<Timer::duration>(laps.get_mean()))
+                << ", p50 = " << ns_time(laps.get_percentile(50))
+                << ", p90 = " << ns_time(laps.get_percentile(90))
+                << ", p99 = " << ns_time(laps.get_percentile(99))
+                << ", p99.9 = " << ns_time(laps.get_percentile(99.9))
+                << ", max = " << ns_time(laps.get_max());
+        }
+        return report.str();
+    }
+
+    std::string ReportLaps(Timer &t, const source_location &where)
+    {
+        if (t.get_laps() == nullptr) return ReportLaps(lap_histogram(1), t.get_ref(), where);
+        return ReportLaps(*t.get_laps(), t.get_ref(), where);
+    }
+
 #if defined(_GPU)
     std::string ReportTimeTakenOnDevice(
         Timer &t, 
@@ -376,6 +1214,16 @@ namespace profiling_util {
     {
         return t.get_on_device();
     }
+
+    std::string ReportTimeTakenOnDevice(Timer &t, const source_location &where)
+    {
+        return ReportTimeTakenOnDevice(t, where.function, where.file, std::to_string(where.line));
+    }
+
+    float GetTimeTakenOnDevice(Timer &t, const source_location &)
+    {
+        return t.get_on_device();
+    }
 #endif
 
 } 